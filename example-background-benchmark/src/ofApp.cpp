@@ -0,0 +1,133 @@
+#include "ofApp.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+const int frames = 30;
+const float learningRate = .01;
+const int thresholdValue = 26;
+
+// the separate passes RunningBackground used before updating in one pass
+class SeparateBackground {
+public:
+	void update(Mat frame, Mat& thresholded) {
+		if(accumulator.empty()) {
+			frame.convertTo(accumulator, CV_32F);
+		}
+		accumulator.convertTo(background, CV_8U);
+		absdiff(background, frame, foreground);
+		copyGray(foreground, foregroundGray);
+		threshold(foregroundGray, thresholded, thresholdValue, 255, THRESH_BINARY);
+		accumulateWeighted(frame, accumulator, learningRate);
+		presence = mean(foreground)[0] / 255.;
+	}
+	Mat accumulator, background, foreground, foregroundGray;
+	float presence;
+};
+
+void ofApp::setup() {
+	ofSetVerticalSync(true);
+	ofBackground(0);
+	
+	results.push_back("size\tseparate ms/frame\tsingle pass ms/frame\tsame mask\tfixed point ms/frame\tsamples ms/frame");
+	benchmark(640, 480);
+	benchmark(1920, 1080);
+	benchmark(3840, 2160);
+	checkIncrementalContours();
+}
+
+void ofApp::benchmark(int width, int height) {
+	// a noisy color scene with a bright square moving across it
+	Mat scene(height, width, CV_8UC3);
+	randu(scene, Scalar::all(0), Scalar::all(128));
+	vector<Mat> sequence;
+	for(int i = 0; i < frames; i++) {
+		Mat frame = scene.clone();
+		int side = height / 4;
+		cv::Rect square((width - side) * i / frames, height / 2 - side / 2, side, side);
+		frame(square).setTo(Scalar::all(255));
+		sequence.push_back(frame);
+	}
+	
+	SeparateBackground separate;
+	RunningBackground single, fixed, samples;
+	single.setLearningRate(learningRate);
+	single.setThresholdValue(thresholdValue);
+	fixed.setUseFixedPoint(true);
+	fixed.setLearningRate(learningRate);
+	fixed.setThresholdValue(thresholdValue);
+	samples.setBackgroundMode(RunningBackground::SAMPLE_CONSENSUS);
+	samples.setThresholdValue(thresholdValue);
+	Mat separateMask, singleMask, fixedMask, samplesMask, gray;
+	uint64_t separateTime = 0, singleTime = 0, fixedTime = 0, samplesTime = 0;
+	double mismatch = 0;
+	for(int i = 0; i < frames; i++) {
+		uint64_t start = ofGetElapsedTimeMicros();
+		separate.update(sequence[i], separateMask);
+		separateTime += ofGetElapsedTimeMicros() - start;
+		start = ofGetElapsedTimeMicros();
+		single.update(sequence[i], singleMask);
+		singleTime += ofGetElapsedTimeMicros() - start;
+		mismatch += countNonZero(separateMask != singleMask) / (double) separateMask.total();
+		start = ofGetElapsedTimeMicros();
+		fixed.update(sequence[i], fixedMask);
+		fixedTime += ofGetElapsedTimeMicros() - start;
+		// the sample model works in gray, so it's timed without the conversion
+		copyGray(sequence[i], gray);
+		start = ofGetElapsedTimeMicros();
+		samples.update(gray, samplesMask);
+		samplesTime += ofGetElapsedTimeMicros() - start;
+	}
+	
+	results.push_back(ofToString(width) + "x" + ofToString(height) + "\t" +
+		ofToString(separateTime / (1000. * frames), 3) + "\t" +
+		ofToString(singleTime / (1000. * frames), 3) + "\t" +
+		ofToString(100 * (1 - mismatch / frames), 3) + "%\t" +
+		ofToString(fixedTime / (1000. * frames), 3) + "\t" +
+		ofToString(samplesTime / (1000. * frames), 3));
+	ofLog() << results.back();
+}
+
+void ofApp::checkIncrementalContours() {
+	// a static scene with a square that moves across it and then leaves. the
+	// incremental finder gets the difference from the last frame, and should
+	// always find the same contours as starting over
+	int width = 640, height = 480, side = 64;
+	Mat scene(height, width, CV_8UC1, Scalar(0));
+	scene(cv::Rect(40, 40, 100, 60)).setTo(Scalar(255));
+	ContourFinder incremental, full;
+	Mat frame, previous, difference;
+	bool same = true;
+	for(int i = 0; i <= frames; i++) {
+		scene.copyTo(frame);
+		if(i < frames) {
+			frame(cv::Rect(200 + 4 * i, 200, side, side)).setTo(Scalar(255));
+		}
+		if(previous.empty()) {
+			difference = Mat();
+		} else {
+			absdiff(frame, previous, difference);
+		}
+		frame.copyTo(previous);
+		incremental.findContours(frame, difference);
+		full.findContours(frame);
+		if(incremental.getBoundingRects() != full.getBoundingRects()) {
+			same = false;
+		}
+	}
+	// only the static blob is left once the square is gone
+	bool removed = incremental.size() == 1;
+	results.push_back(std::string("incremental contours\tsame as full: ") + (same ? "yes" : "no") +
+		"\tsquare removed after leaving: " + (removed ? "yes" : "no"));
+	ofLog() << results.back();
+}
+
+void ofApp::update() {
+}
+
+void ofApp::draw() {
+	ofSetColor(255);
+	for(int i = 0; i < results.size(); i++) {
+		ofDrawBitmapString(results[i], 10, 20 + 20 * i);
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+class ofApp : public ofBaseApp {
+public:
+	void setup();
+	void update();
+	void draw();
+	
+	void benchmark(int width, int height);
+	// checks that an object leaving a static scene is removed by the
+	// incremental ContourFinder update
+	void checkIncrementalContours();
+	
+	std::vector<std::string> results;
+};
@@ -3,6 +3,8 @@
 using namespace ofxCv;
 using namespace cv;
 
+const int tileSize = 32;
+
 void ofApp::setup() {
 	cam.setup(640, 480);
     
@@ -10,6 +12,8 @@ void ofApp::setup() {
     gui.add(resetBackground.set("Reset Background", false));
     gui.add(learningTime.set("Learning Time", 30, 0, 30));
     gui.add(thresholdValue.set("Threshold Value", 10, 0, 255));
+	
+	contourFinder.setMinAreaRadius(10);
 }
 
 void ofApp::update() {
@@ -23,6 +27,24 @@ void ofApp::update() {
         background.setThresholdValue(thresholdValue);
 		background.update(cam, thresholded);
 		thresholded.update();
+		
+		// pass the tiles where the mask changed since the last frame
+		Mat mask = toCv(thresholded);
+		changed.clear();
+		if(previousMask.size() == mask.size()) {
+			absdiff(mask, previousMask, maskDifference);
+			cv::Rect bounds(0, 0, mask.cols, mask.rows);
+			for(int y = 0; y < mask.rows; y += tileSize) {
+				for(int x = 0; x < mask.cols; x += tileSize) {
+					cv::Rect tile = cv::Rect(x, y, tileSize, tileSize) & bounds;
+					if(countNonZero(maskDifference(tile)) > 0) {
+						changed.push_back(tile);
+					}
+				}
+			}
+		}
+		mask.copyTo(previousMask);
+		contourFinder.findContours(thresholded, changed);
 	}
 }
 
@@ -30,6 +52,12 @@ void ofApp::draw() {
 	cam.draw(0, 0);
     if(thresholded.isAllocated()) {
         thresholded.draw(640, 0);
+		ofPushMatrix();
+		ofTranslate(640, 0);
+		ofSetColor(magentaPrint);
+		contourFinder.draw();
+		ofPopMatrix();
+		ofSetColor(255);
     }
     gui.draw();
 }
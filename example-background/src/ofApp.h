@@ -13,6 +13,11 @@ public:
 	ofVideoGrabber cam;
 	ofxCv::RunningBackground background;
 	ofImage thresholded;
+	
+	// the contours are only traced again where the mask changed
+	ofxCv::ContourFinder contourFinder;
+	cv::Mat previousMask, maskDifference;
+	std::vector<cv::Rect> changed;
     
     ofxPanel gui;
     ofParameter<bool> resetBackground;
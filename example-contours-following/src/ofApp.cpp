@@ -73,8 +73,8 @@ void ofApp::draw() {
 	ofSetColor(255);
 	movie.draw(0, 0);
 	contourFinder.draw();
-	vector<Glow>& followers = tracker.getFollowers();
+	const vector<Glow*>& followers = tracker.getFollowerPointers();
 	for(int i = 0; i < followers.size(); i++) {
-		followers[i].draw();
+		followers[i]->draw();
 	}
 }
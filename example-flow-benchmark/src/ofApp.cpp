@@ -0,0 +1,79 @@
+#include "ofApp.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+// every frame is the first frame moved by this many pixels
+const float dx = 1.5, dy = -.75;
+const int frames = 30;
+const int width = 1280, height = 720;
+// the flow is measured away from the edges, where pixels move out of the frame
+const int border = 16;
+
+void ofApp::setup() {
+	ofSetVerticalSync(true);
+	ofBackground(0);
+	
+	// smooth random texture, so every part of the image has something to track
+	Mat noise(height, width, CV_8UC1);
+	randu(noise, Scalar(0), Scalar(255));
+	GaussianBlur(noise, noise, cv::Size(0, 0), 3);
+	normalize(noise, noise, 0, 255, NORM_MINMAX);
+	for(int i = 0; i < frames; i++) {
+		Mat frame;
+		Mat translation = (Mat_<double>(2, 3) << 1, 0, dx * i, 0, 1, dy * i);
+		warpAffine(noise, frame, translation, noise.size(), INTER_LINEAR, BORDER_REFLECT);
+		sequence.push_back(frame);
+	}
+	
+	results.push_back("engine\tms/frame\tendpoint error");
+	FlowFarneback farneback;
+	benchmark("farneback", farneback);
+#if CV_MAJOR_VERSION>=4
+	int presets[] = {DISOpticalFlow::PRESET_ULTRAFAST, DISOpticalFlow::PRESET_FAST, DISOpticalFlow::PRESET_MEDIUM};
+	string names[] = {"dis ultrafast", "dis fast", "dis medium"};
+	for(int i = 0; i < 3; i++) {
+		FlowDIS dis;
+		dis.setPreset(presets[i]);
+		benchmark(names[i], dis);
+	}
+#endif
+}
+
+void ofApp::benchmark(string name, FlowDense& flow) {
+	uint64_t time = 0;
+	double error = 0;
+	cv::Rect inside(border, border, width - 2 * border, height - 2 * border);
+	for(int i = 0; i < frames; i++) {
+		uint64_t start = ofGetElapsedTimeMicros();
+		flow.calcOpticalFlow(sequence[i]);
+		time += ofGetElapsedTimeMicros() - start;
+		if(i > 0) {
+			// average distance between the measured and the true motion
+			Mat_<Vec2f> field = flow.getFlow()(inside);
+			double total = 0;
+			for(int y = 0; y < field.rows; y++) {
+				for(int x = 0; x < field.cols; x++) {
+					const Vec2f& cur = field(y, x);
+					total += sqrt((cur[0] - dx) * (cur[0] - dx) + (cur[1] - dy) * (cur[1] - dy));
+				}
+			}
+			error += total / inside.area();
+		}
+	}
+	
+	results.push_back(name + "\t" +
+		ofToString(time / (1000. * frames), 3) + "\t" +
+		ofToString(error / (frames - 1), 3));
+	ofLog() << results.back();
+}
+
+void ofApp::update() {
+}
+
+void ofApp::draw() {
+	ofSetColor(255);
+	for(int i = 0; i < results.size(); i++) {
+		ofDrawBitmapString(results[i], 10, 20 + 20 * i);
+	}
+}
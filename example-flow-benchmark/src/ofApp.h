@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+class ofApp : public ofBaseApp {
+public:
+	void setup();
+	void update();
+	void draw();
+	
+	void benchmark(std::string name, ofxCv::FlowDense& flow);
+	
+	std::vector<cv::Mat> sequence;
+	std::vector<std::string> results;
+};
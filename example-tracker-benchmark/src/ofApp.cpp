@@ -0,0 +1,194 @@
+#include "ofApp.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace ofxCv;
+using namespace cv;
+
+// every allocation in the app is counted, to check that track() stops
+// allocating once the number of objects has settled
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t size) {
+	allocations++;
+	void* ptr = malloc(size ? size : 1);
+	if(!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+// each point moves up to this many pixels per frame
+const float jitter = 4;
+const float maximumDistance = 16;
+const int frames = 30;
+
+// random points with about the same density at every count
+vector<cv::Point2f> makePoints(int count) {
+	float side = sqrt((float) count) * 32;
+	vector<cv::Point2f> points(count);
+	for(int i = 0; i < count; i++) {
+		points[i] = cv::Point2f(ofRandom(side), ofRandom(side));
+	}
+	return points;
+}
+
+void movePoints(vector<cv::Point2f>& points) {
+	for(int i = 0; i < points.size(); i++) {
+		points[i].x += ofRandom(-jitter, jitter);
+		points[i].y += ofRandom(-jitter, jitter);
+	}
+}
+
+void ofApp::setup() {
+	ofSetVerticalSync(true);
+	ofBackground(0);
+	
+	results.push_back("objects\tbrute ms/frame\tgrid ms/frame\tsame labels");
+	int counts[] = {10, 100, 1000, 10000};
+	for(int i = 0; i < 4; i++) {
+		benchmark(counts[i]);
+	}
+	
+	results.push_back("");
+	results.push_back("objects\tgreedy ms/frame\tswaps/frame\toptimal ms/frame\tswaps/frame");
+	int denseCounts[] = {100, 400, 1600};
+	for(int i = 0; i < 3; i++) {
+		compareMatching(denseCounts[i]);
+	}
+	
+	results.push_back("");
+	results.push_back("objects\tbrute allocations/frame\tgrid allocations/frame");
+	countAllocations(500);
+}
+
+// the same number of points every frame, so after a few frames of warm up
+// the greedy tracker should reuse all of its buffers
+void ofApp::countAllocations(int count) {
+	ofSeedRandom(0);
+	int warmup = 10;
+	vector<vector<cv::Point2f> > sequence;
+	vector<cv::Point2f> points = makePoints(count);
+	for(int i = 0; i < warmup + frames; i++) {
+		movePoints(points);
+		sequence.push_back(points);
+	}
+	
+	string result = ofToString(count);
+	for(int spatial = 0; spatial < 2; spatial++) {
+		PointTracker tracker;
+		tracker.setMaximumDistance(maximumDistance);
+		tracker.setUseSpatialIndex(spatial);
+		unsigned long long total = 0;
+		for(int i = 0; i < warmup + frames; i++) {
+			unsigned long long before = allocations;
+			tracker.track(sequence[i]);
+			if(i >= warmup) {
+				total += allocations - before;
+			}
+		}
+		result += "\t" + ofToString(total / (float) frames, 1);
+	}
+	results.push_back(result);
+	ofLog() << result;
+}
+
+// a lattice of points spaced closer than they move each frame, which is where
+// the greedy matching starts swapping labels.
+void ofApp::compareMatching(int count) {
+	ofSeedRandom(0);
+	int side = sqrt((float) count);
+	float spacing = 6, speed = 5;
+	vector<cv::Point2f> points;
+	for(int y = 0; y < side; y++) {
+		for(int x = 0; x < side; x++) {
+			points.push_back(cv::Point2f(x * spacing, y * spacing));
+		}
+	}
+	vector<vector<cv::Point2f> > sequence;
+	for(int i = 0; i < frames; i++) {
+		for(int j = 0; j < points.size(); j++) {
+			points[j] += cv::Point2f(speed + ofRandom(-1, 1), speed + ofRandom(-1, 1));
+		}
+		sequence.push_back(points);
+	}
+	
+	string result = ofToString(points.size());
+	TrackingMatchMode modes[] = {TRACK_MATCH_GREEDY, TRACK_MATCH_OPTIMAL};
+	for(int mode = 0; mode < 2; mode++) {
+		PointTracker tracker;
+		tracker.setMaximumDistance(maximumDistance);
+		tracker.setUseSpatialIndex(true);
+		tracker.setMatchMode(modes[mode]);
+		// a swap is any point whose label changed since the last frame
+		int swaps = 0;
+		uint64_t time = 0;
+		vector<unsigned int> previousLabels;
+		for(int i = 0; i < frames; i++) {
+			uint64_t start = ofGetElapsedTimeMicros();
+			const vector<unsigned int>& labels = tracker.track(sequence[i]);
+			time += ofGetElapsedTimeMicros() - start;
+			for(int j = 0; j < previousLabels.size(); j++) {
+				if(labels[j] != previousLabels[j]) {
+					swaps++;
+				}
+			}
+			previousLabels = labels;
+		}
+		result += "\t" + ofToString(time / (1000. * frames), 3) + "\t" + ofToString(swaps / (float) (frames - 1), 1);
+	}
+	results.push_back(result);
+	ofLog() << result;
+}
+
+void ofApp::benchmark(int count) {
+	ofSeedRandom(0);
+	vector<vector<cv::Point2f> > sequence;
+	vector<cv::Point2f> points = makePoints(count);
+	for(int i = 0; i < frames; i++) {
+		movePoints(points);
+		sequence.push_back(points);
+	}
+	
+	PointTracker brute, grid;
+	brute.setMaximumDistance(maximumDistance);
+	grid.setMaximumDistance(maximumDistance);
+	grid.setUseSpatialIndex(true);
+	
+	// the n^2 search is too slow to run many frames at the largest counts
+	int bruteFrames = count > 1000 ? 3 : frames;
+	bool same = true;
+	uint64_t bruteTime = 0, gridTime = 0;
+	for(int i = 0; i < frames; i++) {
+		uint64_t start = ofGetElapsedTimeMicros();
+		const vector<unsigned int>& gridLabels = grid.track(sequence[i]);
+		gridTime += ofGetElapsedTimeMicros() - start;
+		if(i < bruteFrames) {
+			start = ofGetElapsedTimeMicros();
+			const vector<unsigned int>& bruteLabels = brute.track(sequence[i]);
+			bruteTime += ofGetElapsedTimeMicros() - start;
+			same = same && (bruteLabels == gridLabels);
+		}
+	}
+	
+	results.push_back(ofToString(count) + "\t" +
+		ofToString(bruteTime / (1000. * bruteFrames), 3) + "\t" +
+		ofToString(gridTime / (1000. * frames), 3) + "\t" +
+		(same ? "yes" : "no"));
+	ofLog() << results.back();
+}
+
+void ofApp::update() {
+}
+
+void ofApp::draw() {
+	ofSetColor(255);
+	for(int i = 0; i < results.size(); i++) {
+		ofDrawBitmapString(results[i], 10, 20 + 20 * i);
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+class ofApp : public ofBaseApp {
+public:
+	void setup();
+	void update();
+	void draw();
+	
+	void benchmark(int count);
+	void compareMatching(int count);
+	void countAllocations(int count);
+	
+	std::vector<std::string> results;
+};
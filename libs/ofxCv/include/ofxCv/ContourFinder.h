@@ -5,7 +5,8 @@
  to track in HSV or just hue space, pass TRACK_COLOR_HSV or TRACK_COLOR_H.
  to change the threshold value, use setThreshold(). by default, the threshold is
  128. when finding bright regions, 128 is halfway between white and black. when
- tracking a color, 0 means "exactly similar" and 255 is "all colors".
+ tracking a color, 0 means "exactly similar" and 255 is "all colors". for 8 bit
+ images the hue goes from 0-255 and wraps around, so red is close to magenta.
  
  by default, the results are unfiltered by area. to filter by area use one of
  set(Min/Max)(Area/Radius/Norm) functions. set(Min/Max)Area is in pixels.
@@ -17,6 +18,55 @@
  you can get contours as std::vector<cv::Point> or ofPolyline. for other features,
  you can use methods of ofPolyline (getArea(), getPerimiter()) or cv methods
  by asking ContourFinder (getContourArea(), getArcLength()).
+ 
+ the polylines, moments, convex hulls, min area rects, ellipses and quads are
+ only computed the first time they are asked for, and then kept until the next
+ findContours(). asking for the same feature twice in one frame is free, but it
+ also means these getters shouldn't be called from multiple threads at once.
+ 
+ for large images with many blobs, call setUseParallel(true). the mask is split
+ into connected components first, which opencv labels in parallel, and then each
+ component is traced, measured and filtered on its own thread. the results
+ are the same contours, in the same order, as the serial contour finder.
+ 
+ if you only need the bounding boxes, centroids and areas, call
+ setStatsOnly(true). the blobs are then measured with connected components
+ instead of being traced, which is much faster for dense masks. the contours
+ and polylines are empty, the area is the number of pixels in the blob, and
+ the centroid is the average of those pixels. holes are never reported, and
+ the area filters, setSortBySize() and the tracker work as usual.
+ 
+ when only part of the image changes from frame to frame, pass the changed
+ regions along with the image: findContours(img, rects), or a mask of the
+ changed pixels with findContours(img, mask). only those regions are
+ thresholded again, and only the blobs they touch are traced again. the
+ regions have to cover every pixel of img that changed since the last call,
+ like the absdiff() of the two frames. the foreground of RunningBackground
+ isn't enough on its own: when a blob leaves, the pixels it left are no longer
+ in the foreground, so its old contour would stay. example-background passes
+ the tiles where the thresholded mask changed. the mask is still labelled as a
+ whole, so holes and nesting are exact and the results are the same as calling
+ findContours(img). changing a setting or calling findContours(img) makes the
+ next update start over.
+ 
+ getFlatContours() packs every contour into one buffer of points, with the
+ start of each contour in offsets (and one extra offset at the end), next to
+ arrays of the bounding boxes, areas, holes and labels. the points are floats,
+ so they can go into an ofVbo or be sent to another thread in one copy.
+ getFlatContour(i) is a view of a single contour in that buffer. the contours
+ are still found and kept as std::vector<cv::Point>, so the first
+ getFlatContours() after each findContours() copies every point of every
+ contour, which is O(points). later calls in the same frame are free. it
+ saves flattening the contours yourself, not the copy.
+ 
+ like ObjectFinder, the contour finder can work on a smaller copy of the image.
+ setRescale(.5) thresholds and traces a quarter of the pixels, and setRescale(.25)
+ a sixteenth. the contours, bounding boxes, areas and centroids are scaled back
+ up, and the area filters are still in full resolution pixels. small blobs
+ lose the most detail, so setRefineMaxArea() traces blobs smaller than the
+ given area again from the full resolution image. holes are never refined.
+ the refined areas go through the area filters and setSortBySize() again.
+ rescaling skips the incremental update, the changed regions are ignored.
  */
 
 // to implement in ContourFinder:
@@ -34,6 +84,41 @@ namespace ofxCv {
 	
 	enum TrackingColorMode {TRACK_COLOR_RGB, TRACK_COLOR_HSV, TRACK_COLOR_H, TRACK_COLOR_HS};
 	
+	// a read only view of elements stored one after another, which doesn't own
+	// or copy them
+	template <class T>
+	class ConstSpan {
+	public:
+		ConstSpan()
+		:ptr(NULL)
+		,n(0) {
+		}
+		ConstSpan(const T* ptr, std::size_t n)
+		:ptr(ptr)
+		,n(n) {
+		}
+		const T* data() const {return ptr;}
+		std::size_t size() const {return n;}
+		bool empty() const {return n == 0;}
+		const T* begin() const {return ptr;}
+		const T* end() const {return ptr + n;}
+		const T& operator[](std::size_t i) const {return ptr[i];}
+	protected:
+		const T* ptr;
+		std::size_t n;
+	};
+	
+	// every contour from one frame, one array per property
+	struct FlatContours {
+		std::vector<cv::Point2f> points;
+		std::vector<unsigned int> offsets;
+		std::vector<cv::Rect> rects;
+		std::vector<double> areas;
+		std::vector<unsigned char> holes;
+		std::vector<unsigned int> labels;
+		std::size_t size() const {return rects.size();}
+	};
+	
 	class ContourFinder {
 	public:
 		ContourFinder();
@@ -43,9 +128,27 @@ namespace ofxCv {
 			findContours(toCv(img));
 		}
 		void findContours(cv::Mat img);
+		template <class T>
+		void findContours(T& img, const std::vector<cv::Rect>& changed) {
+			findContours(toCv(img), changed);
+		}
+		// without this, a non-const vector of rects would be taken as a mask
+		template <class T>
+		void findContours(T& img, std::vector<cv::Rect>& changed) {
+			findContours(toCv(img), (const std::vector<cv::Rect>&) changed);
+		}
+		template <class T, class M>
+		void findContours(T& img, M& changed) {
+			findContours(toCv(img), toCv(changed));
+		}
+		void findContours(cv::Mat img, const std::vector<cv::Rect>& changed);
+		void findContours(cv::Mat img, cv::Mat changed);
 		const std::vector<std::vector<cv::Point> >& getContours() const;
 		const std::vector<ofPolyline>& getPolylines() const;
 		const std::vector<cv::Rect>& getBoundingRects() const;
+		// copies every contour the first time it's called after findContours()
+		const FlatContours& getFlatContours() const;
+		ConstSpan<cv::Point2f> getFlatContour(unsigned int i) const;
 		
 		unsigned int size() const;
 		std::vector<cv::Point>& getContour(unsigned int i);
@@ -58,12 +161,12 @@ namespace ofxCv {
 		cv::Vec2f getBalance(unsigned int i) const;         // difference between centroid and center
 		double getContourArea(unsigned int i) const;
 		double getArcLength(unsigned int i) const;
-		std::vector<cv::Point> getConvexHull(unsigned int i) const;
+		const std::vector<cv::Point>& getConvexHull(unsigned int i) const;
 		std::vector<cv::Vec4i> getConvexityDefects(unsigned int i) const;
 		cv::RotatedRect getMinAreaRect(unsigned int i) const;
 		cv::Point2f getMinEnclosingCircle(unsigned int i, float& radius) const;
 		cv::RotatedRect getFitEllipse(unsigned int i) const;
-        std::vector<cv::Point> getFitQuad(unsigned int i) const;
+        const std::vector<cv::Point>& getFitQuad(unsigned int i) const;
         bool getHole(unsigned int i) const;
 		cv::Vec2f getVelocity(unsigned int i) const;
 		
@@ -82,6 +185,11 @@ namespace ofxCv {
 		void setTargetColor(ofColor targetColor, TrackingColorMode trackingColorMode = TRACK_COLOR_RGB);
 		void setFindHoles(bool findHoles);
 		void setSortBySize(bool sortBySize);
+		void setUseParallel(bool useParallel);
+		void setStatsOnly(bool statsOnly);
+		void setRescale(float rescale);
+		void setRefineMaxArea(float refineMaxArea);
+		float getRescale() const;
 		
 		void resetMinArea();
 		void resetMaxArea();
@@ -98,6 +206,9 @@ namespace ofxCv {
 
 	protected:
 		cv::Mat hsvBuffer, thresh;
+		void thresholdMask(const cv::Mat& img, cv::Mat& dst);
+		void thresholdImage(const cv::Mat& img, cv::Mat& dst);
+		void findBlobs(const cv::Mat& img, bool keepComponents, bool reuseComponents);
 		bool autoThreshold, invert, simplify;
 		float thresholdValue;
 		
@@ -109,14 +220,93 @@ namespace ofxCv {
 		bool minAreaNorm, maxAreaNorm;
 		
 		std::vector<std::vector<cv::Point> > contours;
-		std::vector<ofPolyline> polylines;
+		mutable std::vector<ofPolyline> polylines;
+		std::vector<double> areas;
+		
+		// features that are computed on demand, flagged in computed
+		enum {
+			FEATURE_POLYLINE = 1 << 0,
+			FEATURE_MOMENTS = 1 << 1,
+			FEATURE_CONVEX_HULL = 1 << 2,
+			FEATURE_MIN_AREA_RECT = 1 << 3,
+			FEATURE_FIT_ELLIPSE = 1 << 4,
+			FEATURE_FIT_QUAD = 1 << 5
+		};
+		struct ContourFeatures {
+			unsigned int computed;
+			cv::Moments moments;
+			std::vector<cv::Point> convexHull, fitQuad;
+			cv::RotatedRect minAreaRect, fitEllipse;
+		};
+		mutable std::vector<ContourFeatures> features;
+		bool needsFeature(unsigned int i, unsigned int feature) const;
+		mutable FlatContours flat;
+		mutable bool flatReady;
+		const cv::Moments& getMoments(unsigned int i) const;
 		
 		RectTracker tracker;
         std::vector<cv::Rect> boundingRects;
         std::vector<bool> holes;
+		
+		// kept between frames so findContours() doesn't need to allocate
+		std::vector<std::vector<cv::Point> > allContours;
+		std::vector<size_t> allIndices;
+		std::vector<double> allAreas;
+		std::vector<bool> allHoles;
 
 		int contourFindingMode;
 		bool sortBySize;
+		
+		// parallel contour finding, one component at a time
+		struct TracedContour {
+			long long key;
+			int component, index;
+			double area;
+			bool hole, kept;
+			cv::Rect rect;
+		};
+		struct CompareTracedContour;
+		bool useParallel;
+		cv::Mat componentLabels, componentStats, componentCentroids;
+		cv::Mat background, backgroundLabels;
+		std::vector<unsigned char> exterior;
+		struct Component {
+			unsigned int key;
+			bool traced, visible;
+			std::vector<std::vector<cv::Point> > contours;
+			std::vector<TracedContour> found;
+		};
+		std::vector<Component> components;
+		std::vector<int> pending;
+		std::vector<TracedContour> traced;
+		std::vector<cv::Rect> allRects;
+		
+		// measuring the components without tracing them
+		bool statsOnly;
+		std::vector<cv::Point2f> allCentroids, centroids;
+		void findComponentStats(double minArea, double maxArea);
+		
+		// components away from the changed regions are kept from the last frame
+		bool needsFullUpdate;
+		std::vector<cv::Rect> dirtyRects, changedTiles;
+		std::vector<Component> previousComponents;
+		LabelIndex previousComponentIndex;
+		bool isDirty(const cv::Rect& rect) const;
+		
+		// finding the blobs in a smaller image
+		float rescale, refineMaxArea;
+		cv::Mat resized, refineMask;
+		std::vector<std::vector<cv::Point> > refineContours;
+		void scaleBlobs(const cv::Mat& img);
+		bool refineBlob(const cv::Mat& img, size_t i, const cv::Point2f& scale);
+		
+		class ParallelComponents;
+		int labelComponents();
+		cv::Rect getComponentRect(int label) const;
+		cv::Point getFirstPixel(int label) const;
+		bool isExterior(int label) const;
+		void findContoursByComponent(double minArea, double maxArea, bool keepComponents, bool reuseComponents);
+		void traceComponent(int label, cv::Mat& mask, double minArea, double maxArea);
 	};	
 	
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "ofxCv.h"
+#include <memory>
+#include <mutex>
 
 namespace ofxCv {
 	
@@ -8,6 +10,9 @@ namespace ofxCv {
 	public:
         // should constructor be protected?
 		Flow();
+		//copies start with async off. don't copy while async is on
+		Flow(const Flow& other);
+		Flow& operator=(const Flow& other);
 		virtual ~Flow();
 		
 		//call these functions to calculate flow on sequential images.
@@ -29,6 +34,28 @@ namespace ofxCv {
         }
 		void calcOpticalFlow(cv::Mat nextImage);
 		
+		//computes the flow on a worker thread. calcOpticalFlow(nextImage)
+		//then returns right away, and the flow that is drawn and returned
+		//is the newest one the worker has finished. if frames come in faster
+		//than the worker can handle them, the older waiting frame is dropped.
+		//only calcOpticalFlow(nextImage) works this way, and the settings of
+		//each engine should be changed while async is off. the features given
+		//to FlowPyrLK are the exception, they're used from the next frame
+		//that the worker starts. the worker's state is only created the first
+		//time async is turned on
+		void setUseAsync(bool useAsync);
+		//picks up the newest finished flow, which calcOpticalFlow() also
+		//does. returns true if there was a newer one
+		bool update();
+		//the number of the frame that the current flow ends on, counting
+		//the frames given to calcOpticalFlow() from 1. 0 means no flow yet
+		unsigned long long getFrameId() const;
+		unsigned long long getDroppedFrames() const;
+		//milliseconds from giving a frame to calcOpticalFlow() until its flow
+		//was finished, for the current flow and on average
+		float getLatency() const;
+		float getAverageLatency() const;
+		
 		void draw();
 		void draw(float x, float y);
 		void draw(float x, float y, float width, float height);
@@ -36,22 +63,66 @@ namespace ofxCv {
 		int getWidth();
 		int getHeight();
         
+        //call this if you switch to a new video file to reset internal caches
         virtual void resetFlow();
         
     private:
 		cv::Mat last, curr;
+		void runFlow(cv::Mat nextImage);
+		
+		//async worker, with one waiting frame and three result slots. the
+		//worker fills one slot while the newest finished one waits in the
+		//middle and the caller reads from the last one
+		struct ResultInfo {
+			unsigned long long frameId;
+			float latency;
+			bool hasFlow;
+			cv::Size size;
+		};
+		struct AsyncState;
+		bool useAsync;
+		std::unique_ptr<AsyncState> async;
+		unsigned long long frameCount;
+		ResultInfo shown;
+		double totalLatency;
+		unsigned long long shownCount;
+		void startWorker();
+		void threadedFunction();
         
     protected:
-		bool hasFlow;
+		//true once calcFlow() has run, used by the engines. the getters and
+		//draw() use hasResult, which is the same unless async is on
+		bool hasFlow, hasResult;
+		
+		//joins the worker. engines that support async call this in their
+		//destructor, before their state goes away
+		void stopWorker();
+		
+		//clears the state of the engine, called by resetFlow() while the
+		//worker is stopped
+		virtual void clearFlow();
+		
+		//engines hold this lock while they ask for a change from the
+		//caller's thread. it doesn't lock anything when async is off.
+		//applyRequests() makes the changes, on the worker with the lock held
+		//before each frame, or right before calcFlow() when async is off
+		std::unique_lock<std::mutex> lockRequests();
+		virtual void applyRequests() {}
 		
 		//specific flow implementation
 		virtual void calcFlow(cv::Mat prev, cv::Mat next) = 0;
 		//specific drawing implementation
 		virtual void drawFlow(ofRectangle r) = 0;
+		//async support: storeResult() copies the output of the last calcFlow()
+		//into one of three slots on the worker thread, and showResult() makes
+		//a slot the one the getters read. slot -1 is the output of calcFlow()
+		//itself, which is used when async is off
+		virtual void storeResult(int slot) {}
+		virtual void showResult(int slot) {}
 	};
 	
-	//there are two implementations of Flow
-	//use Farneback for a dense flow field, 
+	//there are three implementations of Flow
+	//use Farneback or DIS for a dense flow field, 
 	//use PyrLK for specific features
 	
 	//see http://opencv.willowgarage.com/documentation/cpp/motion_analysis_and_object_tracking.html
@@ -72,21 +143,47 @@ namespace ofxCv {
 		void setQualityLevel(float qualityLevel);
 		void setPyramidLevels(int levels);
 		
+		//when fewer than minFeatures are still tracked, new features are
+		//found away from the old ones, up to maxFeatures. 0 turns this off
+		void setMinFeatures(int minFeatures);
+		
+		//tracks every feature back to the last frame, and drops the ones that
+		//end up further than maxForwardBackwardError pixels from where they were
+		void setUseForwardBackward(bool useForwardBackward);
+		void setMaxForwardBackwardError(float maxForwardBackwardError);
+		
 		//returns tracking features for this image
 		std::vector<glm::vec3> getFeatures();
 		std::vector<glm::vec2> getCurrent();
 		std::vector<glm::vec2> getMotion();
 		
-		// recalculates features to track
+		//the same, filling vectors that can be reused every frame
+		void getFeatures(std::vector<glm::vec3> & features) const;
+		void getCurrent(std::vector<glm::vec2> & current) const;
+		void getMotion(std::vector<glm::vec2> & motion) const;
+		
+		//the features before and after this frame, lined up with the status
+		//of each one. lost features have a status of 0
+		const std::vector<cv::Point2f>& getPrevPoints() const;
+		const std::vector<cv::Point2f>& getNextPoints() const;
+		const std::vector<uchar>& getStatus() const;
+		
+		// recalculates features to track. with async on, the worker
+		// starts using them from its next frame
 		void resetFeaturesToTrack();
 		void setFeaturesToTrack(const std::vector<glm::vec2> & features);
 		void setFeaturesToTrack(const std::vector<cv::Point2f> & features);
-        void resetFlow();
 	protected:
+		void clearFlow();
+		void applyRequests();
 		
 		void drawFlow(ofRectangle r);
 		void calcFlow(cv::Mat prev, cv::Mat next);
 		void calcFeaturesToTrack(std::vector<cv::Point2f> & features, cv::Mat next);
+		void refillFeatures(cv::Mat prev);
+		void checkForwardBackward();
+		void storeResult(int slot);
+		void showResult(int slot);
 		
 		std::vector<cv::Point2f> prevPts, nextPts;
 		
@@ -99,19 +196,88 @@ namespace ofxCv {
 		//min distance for PyrLK 
 		int minDistance;
 		
-		//pyramid levels
+		//pyramid levels, at most maxLevel are built
 		int pyramidLevels;
 		
+		//feature refilling
+		int minFeatures;
+		cv::Mat featureMask;
+		std::vector<cv::Point2f> newPts;
+		
+		//forward-backward check
+		bool useForwardBackward;
+		float maxForwardBackwardError;
+		std::vector<cv::Point2f> backPts;
+		std::vector<uchar> backStatus;
+		std::vector<float> backErr;
+		
 		bool calcFeaturesNextFrame;
 		
-		//pyramid + err/status data
+		//features asked for from the caller's thread
+		enum FeatureRequest {REQUEST_NONE, REQUEST_FIND, REQUEST_POINTS};
+		FeatureRequest featureRequest;
+		std::vector<cv::Point2f> requestedPts;
+		
+		//pyramid + err/status data, the pyramids are swapped each frame
 		std::vector<cv::Mat> pyramid;
 		std::vector<cv::Mat> prevPyramid;
 		std::vector<uchar> status;
 		std::vector<float> err;
+		
+		//what the getters read, the working points (-1) or an async result slot
+		std::vector<cv::Point2f> resultPrevPts[3], resultNextPts[3];
+		std::vector<uchar> resultStatus[3];
+		int shownSlot;
+	};
+	
+	//the dense flow field, shared by FlowFarneback and FlowDIS
+	class FlowDense : public Flow {
+	public:
+		FlowDense();
+		
+		//with async on, the worker can write over this Mat after the next
+		//update() or calcOpticalFlow(), so clone() it to keep it longer
+		cv::Mat& getFlow();
+		glm::vec2 getTotalFlow();
+		glm::vec2 getAverageFlow();
+		glm::vec2 getFlowOffset(int x, int y);
+		glm::vec2 getFlowPosition(int x, int y);
+		
+		//the region queries use a summed area table of the flow, which is
+		//built on the first query after each frame. after that every query
+		//takes the same time, no matter how big the region is. regions are
+		//clipped to the flow field, and averages are over the clipped area
+		glm::vec2 getTotalFlowInRegion(ofRectangle region);
+		glm::vec2 getAverageFlowInRegion(ofRectangle region);
+		void getTotalFlowInRegions(const std::vector<ofRectangle>& regions, std::vector<glm::vec2>& totals);
+		void getAverageFlowInRegions(const std::vector<ofRectangle>& regions, std::vector<glm::vec2>& averages);
+		
+		//the length of the flow vectors, which doesn't cancel out when
+		//different parts of the region move in different directions
+		float getTotalMagnitudeInRegion(ofRectangle region);
+		float getAverageMagnitudeInRegion(ofRectangle region);
+		
+		//call this if you change the result of getFlow() yourself
+		void resetIntegrals();
+		
+	protected:
+		//flow is worked on by calcFlow(), field is what the getters read
+		cv::Mat flow, field;
+		cv::Mat results[3];
+		void storeResult(int slot);
+		void showResult(int slot);
+		
+		cv::Mat flowIntegral, magnitude, magnitudeIntegral;
+		std::vector<cv::Mat> flowChannels;
+		bool flowIntegralReady, magnitudeIntegralReady;
+		const cv::Mat& getFlowIntegral();
+		const cv::Mat& getMagnitudeIntegral();
+		cv::Rect getRegionRect(ofRectangle region) const;
+		
+		void drawFlow(ofRectangle rect);
 	};
 	
-	class FlowFarneback : public Flow {
+	class FlowFarneback : public FlowDense {
 	public:
 		
 		FlowFarneback();
@@ -127,22 +293,9 @@ namespace ofxCv {
 		void setPolyN(int polyN);
 		void setPolySigma(float polySigma);
 		void setUseGaussian(bool gaussian);
-		
-		cv::Mat& getFlow();
-		glm::vec2 getTotalFlow();
-		glm::vec2 getAverageFlow();
-		glm::vec2 getFlowOffset(int x, int y);
-		glm::vec2 getFlowPosition(int x, int y);
-		glm::vec2 getTotalFlowInRegion(ofRectangle region);
-		glm::vec2 getAverageFlowInRegion(ofRectangle region);
-		
-        //call this if you switch to a new video file to reset internal caches
-        void resetFlow();
     
 	protected:
-		cv::Mat flow;
-
-		void drawFlow(ofRectangle rect);
+		void clearFlow();
 		void calcFlow(cv::Mat prev, cv::Mat next);
 		
 		float pyramidScale;
@@ -154,4 +307,24 @@ namespace ofxCv {
 		bool farnebackGaussian;
 	};
 	
+#if CV_MAJOR_VERSION>=4
+	//dense inverse search, a much faster dense flow than Farneback.
+	//like Farneback, each frame starts from the flow of the frame before
+	class FlowDIS : public FlowDense {
+	public:
+		
+		FlowDIS();
+		virtual ~FlowDIS();
+		
+		//cv::DISOpticalFlow::PRESET_ULTRAFAST, PRESET_FAST or PRESET_MEDIUM
+		void setPreset(int preset);
+		
+	protected:
+		void clearFlow();
+		void calcFlow(cv::Mat prev, cv::Mat next);
+		
+		cv::Ptr<cv::DISOpticalFlow> dis;
+	};
+#endif
+	
 }
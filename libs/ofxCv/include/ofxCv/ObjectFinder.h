@@ -13,6 +13,16 @@
  maximum size for searching the space. you can set all these parameters at once
  with a preset using (for example) setPreset(ObjectFinder::Fast).
  
+ the classifier is the slowest part of the update. setDetectionInterval(5) only
+ runs it every 5th frame, and follows each object between detections by
+ matching the patch it was detected in against a window around its last
+ position. if the best match for any object is worse than
+ setMinTrackingConfidence() (0-1, .5 by default), the classifier runs on that
+ frame instead. new objects are only found when the classifier runs.
+ getConfidence() is the match score of each object (1 on detection frames) and
+ getDetectionCount() is the number of times the classifier has run. the tracker
+ labels work the same either way.
+ 
  need to add:
  - allow rotations
  */
@@ -41,6 +51,8 @@ namespace ofxCv {
 		RectTracker& getTracker();
 		unsigned int getLabel(unsigned int i) const;
 		cv::Vec2f getVelocity(unsigned int i) const;
+		float getConfidence(unsigned int i) const;
+		unsigned int getDetectionCount() const;
 		void draw() const;
 		
 		enum Preset {Fast,	Accurate, Sensitive};
@@ -54,6 +66,8 @@ namespace ofxCv {
 		void setUseHistogramEqualization(bool useHistogramEqualization);
 		void setMinSizeScale(float minSizeScale);
 		void setMaxSizeScale(float maxSizeScale);
+		void setDetectionInterval(int detectionInterval);
+		void setMinTrackingConfidence(float minTrackingConfidence);
 		
 		float getRescale() const;
 		int getMinNeighbors() const;
@@ -63,6 +77,8 @@ namespace ofxCv {
 		bool getUseHistogramEqualization() const;
 		float getMinSizeScale() const;
 		float getMaxSizeScale() const;
+		int getDetectionInterval() const;
+		float getMinTrackingConfidence() const;
 		
 	protected:
 		float rescale, multiScaleFactor;
@@ -73,5 +89,17 @@ namespace ofxCv {
 		cv::CascadeClassifier classifier;
 		std::vector<cv::Rect> objects;
 		RectTracker tracker;
+		
+		// following the objects between detections, in the rescaled image
+		int detectionInterval, framesSinceDetection;
+		float minTrackingConfidence;
+		bool needsDetection;
+		unsigned int detectionCount;
+		std::vector<cv::Rect> objectsSmall;
+		std::vector<cv::Mat> templates;
+		std::vector<float> confidences;
+		cv::Mat matchResult;
+		void detectObjects(cv::Mat& graySmallMat);
+		bool followObjects(cv::Mat& graySmallMat);
 	};
 }
@@ -25,6 +25,30 @@
  foreground is completely white. most of the time it will take longer than
  learningTime, so it's safe to under-shoot.
 
+ 8 bit frames with 1, 3 or 4 channels are updated in a single pass over each
+ row, which rounds the background, takes the difference, thresholds it and
+ learns the frame at the same time. getPresence() is measured in that pass.
+ other frames go through the separate opencv functions.
+
+ the background is accumulated in floats, 4 bytes per channel. on machines
+ where memory bandwidth is the limit, call setUseFixedPoint(true) to keep it as
+ 16 bit 8.8 fixed point instead, updated with integer math. the learning rate
+ is rounded to the nearest power of two, so the learned background stays
+ within 1 of the float background when the rate is a power of two. switching
+ this on or off starts learning again. only 8 bit frames use fixed point.
+
+ for scenes with moving leaves, flicker or screens in the background, call
+ setBackgroundMode(SAMPLE_CONSENSUS). instead of one average, every pixel keeps
+ a set of gray values it has seen before (setSampleCount(), 20 by default). a
+ pixel is foreground when fewer than setMinMatches() of them (2 by default) are
+ within the threshold value. background pixels replace one of their samples
+ 1 in setUpdateFactor() frames (16 by default), and also spread into a
+ neighbor's samples, so the model learns anything that keeps coming back.
+ the frame is split into bands of rows that are updated on separate threads.
+ in this mode getForeground() is the same as the thresholded image, and
+ getPresence() is the fraction of foreground pixels. the learning rate,
+ difference mode and setIgnoreForeground() only apply to RUNNING_AVERAGE.
+
  to do:
  - use hsb space, or sb space for differencing (like ContourFinder)
  */
@@ -37,6 +61,7 @@ namespace ofxCv {
 	class RunningBackground {
 	public:
 		enum DifferenceMode {ABSDIFF, BRIGHTER, DARKER};
+		enum BackgroundMode {RUNNING_AVERAGE, SAMPLE_CONSENSUS};
 
 		RunningBackground();
 		template <class F, class T>
@@ -55,6 +80,11 @@ namespace ofxCv {
 		void setLearningTime(double learningTime);
 		void setIgnoreForeground(bool ignoreForeground);
 		void setDifferenceMode(DifferenceMode differenceMode);
+		void setUseFixedPoint(bool useFixedPoint);
+		void setBackgroundMode(BackgroundMode backgroundMode);
+		void setSampleCount(int sampleCount);
+		void setMinMatches(int minMatches);
+		void setUpdateFactor(int updateFactor);
 		void reset();
 	protected:
 		cv::Mat accumulator, background, foreground, foregroundGray;
@@ -62,5 +92,24 @@ namespace ofxCv {
 		unsigned int thresholdValue;
 		bool useLearningTime, needToReset, ignoreForeground;
 		DifferenceMode differenceMode;
+		float presence;
+		bool useFixedPoint;
+		unsigned int frameCount;
+		
+		// sample consensus model
+		BackgroundMode backgroundMode;
+		int sampleCount, minMatches, updateFactor;
+		std::vector<cv::Mat> samples;
+		cv::Mat grayBuffer, backgroundSum;
+		bool needsBackground;
+		cv::RNG rng;
+		std::vector<unsigned int> randomTable, rowOffsets;
+		std::vector<int> bandCounts;
+		// scratch rows for each band, kept between frames
+		std::vector<const uchar*> bandSampleRows;
+		std::vector<uchar> bandMatches;
+		class ParallelSamples;
+		void updateSamples(cv::Mat frame, cv::Mat& thresholded);
+		void updateSampleBand(const cv::Mat& gray, cv::Mat& thresholded, int band);
 	};
 }
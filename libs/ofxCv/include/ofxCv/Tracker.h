@@ -20,12 +20,49 @@
  tracking more than a few hundred objects. to optimize the tracker, consider
  avoiding usage of sqrt() in the trackingDistance() function.
  
- this tracker doesn't find a global minimum, but a local minimum. for example:
- when a dense set of points moves farther than the average point-to-point radius
- (like a line of points 5 pixels apart moving up and to the right 5 pixels). it
+ the distances between one new object and all the previous objects are
+ computed together by TrackingDistanceBatch. for cv::Rect, cv::Point2f,
+ ofRectangle and ofVec2f the previous objects are stored as arrays of floats
+ and compared four at a time with simd instructions. other types fall back to
+ calling trackingDistance() once per pair.
+ 
+ for large numbers of objects, call setUseSpatialIndex(true). the tracker will
+ then hash the previous objects into a grid of maximumDistance sized cells and
+ only call the distance function for objects in neighboring cells. this
+ requires a TrackingPosition specialization for the tracked type (provided for
+ cv::Rect, cv::Point2f, ofRectangle and ofVec2f) and gives exactly the same
+ labels as the n^2 search.
+ 
+ with thousands of objects, setUseParallel(true) splits the new objects into
+ stripes that find and sort their possible matches on separate threads with
+ cv::parallel_for_. the sorted stripes are then merged in pairs, with the
+ pairs at each level merged in parallel. the merge order is fixed, so the
+ labels are identical to the single threaded results. when tracking your own
+ types, trackingDistance() must be safe to call from multiple threads.
+ 
+ by default this tracker doesn't find a global minimum, but a local minimum.
+ for example: when a dense set of points moves farther than the average
+ point-to-point radius (like a line of points 5 pixels apart moving up and to
+ the right 5 pixels). call setMatchMode(TRACK_MATCH_OPTIMAL) to find the
+ matching with the smallest total distance instead. this finds shortest
+ augmenting paths that only follow the possible matches, so the cost grows with
+ the number of matches within maximumDistance rather than with n^2. the tracker
  also fails to model the data, so two objects might be swapped if they cross
  paths quickly.
  
+ every tracked object keeps the velocity of its TrackingPosition, measured in
+ pixels per frame. by default, objects are matched against where they were last
+ seen. with setUsePrediction(true) they are matched against where they would be
+ if they kept moving at that velocity. fast objects then stay within a small
+ maximumDistance, which keeps the number of possible matches low and avoids
+ swaps. this uses a constant velocity model, and needs a TrackingPosition
+ specialization for the tracked type. new objects don't have a velocity yet, so
+ maximumDistance still needs to cover how far they move in their first frame.
+ 
+ the tracker keeps all of its buffers between frames, and labels are looked up
+ with a flat hash map. once the number of objects has settled, track() doesn't
+ allocate any memory as long as the greedy matching is used.
+ 
  usually you don't just want to know the labels of tracked objects, but you also
  want to maintain a collection of your own objects that are paired with those
  tracked/labeled objects. use the TrackerFollower extension for this: create
@@ -40,6 +77,15 @@
  MyFollower::setup(), when an old label is updated MyFollower::update(),
  then when a label has been lost it will switch to MyFollower::kill(). when
  MyFollower::getDead() is true, the MyFollower object will be removed. 
+ 
+ followers are stored in a pool that never moves them, so pointers and
+ references to a follower stay valid until it is removed. getFollowerPointers()
+ returns pointers to the alive followers, and getFollower() finds the follower
+ for a label in constant time. removing a follower swaps the last follower
+ into its place, so the order of the followers changes over time.
+ getFollowers() is deprecated. it now returns a read-only copy of every
+ follower, made on each call, so changes have to go through
+ getFollowerPointers() or getFollower() instead.
  */
 
 #pragma once
@@ -47,17 +93,267 @@
 #include "opencv2/opencv.hpp"
 #include <utility>
 #include <map>
+#include <deque>
+#include <new>
+#include <limits>
+#include <algorithm>
 #include "ofMath.h"
+#include "ofxCv/Utilities.h"
 
 namespace ofxCv {
 	float trackingDistance(const cv::Rect& a, const cv::Rect& b);
 	float trackingDistance(const cv::Point2f& a, const cv::Point2f& b);
+	float trackingDistance(const ofRectangle& a, const ofRectangle& b);
+	float trackingDistance(const ofVec2f& a, const ofVec2f& b);
+	
+	enum TrackingMatchMode {TRACK_MATCH_GREEDY, TRACK_MATCH_OPTIMAL};
+	
+	// finds the assignment of n new objects to m previous objects that has the
+	// smallest total distance, where leaving an object unmatched costs
+	// unmatchedCost. candidates are ((new, previous), distance) pairs, and the
+	// result is the matching previous index (or -1) for every new object.
+	void trackingOptimalAssignment(int n, int m,
+								   const std::vector<std::pair<std::pair<int, int>, float> >& candidates,
+								   float unmatchedCost,
+								   std::vector<int>& assignment);
+	
+	// the position of an object for the spatial index. the distance between two
+	// positions must never be larger than the trackingDistance() between the two
+	// objects. specialize this for your own types to use setUseSpatialIndex().
+	// translate() moves an object by an offset, and is used for prediction.
+	template <class T>
+	struct TrackingPosition {
+		static const bool available = false;
+		static cv::Point2f get(const T& object) {
+			return cv::Point2f(0, 0);
+		}
+		static T translate(const T& object, const cv::Point2f& offset) {
+			return object;
+		}
+	};
+	
+	template <>
+	struct TrackingPosition<cv::Rect> {
+		static const bool available = true;
+		static cv::Point2f get(const cv::Rect& object) {
+			return cv::Point2f(object.x + object.width / 2., object.y + object.height / 2.);
+		}
+		static cv::Rect translate(const cv::Rect& object, const cv::Point2f& offset) {
+			return object + cv::Point(cvRound(offset.x), cvRound(offset.y));
+		}
+	};
+	
+	template <>
+	struct TrackingPosition<cv::Point2f> {
+		static const bool available = true;
+		static cv::Point2f get(const cv::Point2f& object) {
+			return object;
+		}
+		static cv::Point2f translate(const cv::Point2f& object, const cv::Point2f& offset) {
+			return object + offset;
+		}
+	};
+	
+	template <>
+	struct TrackingPosition<ofRectangle> {
+		static const bool available = true;
+		static cv::Point2f get(const ofRectangle& object) {
+			return TrackingPosition<cv::Rect>::get(toCv(object));
+		}
+		static ofRectangle translate(const ofRectangle& object, const cv::Point2f& offset) {
+			return ofRectangle(object.x + offset.x, object.y + offset.y, object.width, object.height);
+		}
+	};
+	
+	template <>
+	struct TrackingPosition<ofVec2f> {
+		static const bool available = true;
+		static cv::Point2f get(const ofVec2f& object) {
+			return toCv(object);
+		}
+		static ofVec2f translate(const ofVec2f& object, const cv::Point2f& offset) {
+			return ofVec2f(object.x + offset.x, object.y + offset.y);
+		}
+	};
+	
+	// computes the trackingDistance() from one object to a range of targets.
+	// this generic version calls trackingDistance() for every target, the
+	// specializations below store the targets in a simd-friendly layout.
+	template <class T>
+	class TrackingDistanceBatch {
+	protected:
+		std::vector<const T*> targets;
+	public:
+		void clear() {
+			targets.clear();
+		}
+		// the target must stay alive until clear() is called
+		void push_back(const T& target) {
+			targets.push_back(&target);
+		}
+		std::size_t size() const {
+			return targets.size();
+		}
+		// distances to the targets in [begin, end) are written to distances.
+		// distances of maximumDistance or more may be returned as infinity.
+		void getDistances(const T& object, int begin, int end, float maximumDistance, float* distances) const {
+			for(int k = begin; k < end; k++) {
+				distances[k - begin] = trackingDistance(object, *targets[k]);
+			}
+		}
+	};
+	
+	template <>
+	class TrackingDistanceBatch<cv::Rect> {
+	protected:
+		// centers and sizes
+		std::vector<float> x, y, width, height;
+	public:
+		void clear();
+		void push_back(const cv::Rect& target);
+		std::size_t size() const;
+		void getDistances(const cv::Rect& object, int begin, int end, float maximumDistance, float* distances) const;
+	};
+	
+	template <>
+	class TrackingDistanceBatch<cv::Point2f> {
+	protected:
+		std::vector<float> x, y;
+	public:
+		void clear();
+		void push_back(const cv::Point2f& target);
+		std::size_t size() const;
+		void getDistances(const cv::Point2f& object, int begin, int end, float maximumDistance, float* distances) const;
+	};
+	
+	template <>
+	class TrackingDistanceBatch<ofRectangle> : public TrackingDistanceBatch<cv::Rect> {
+	public:
+		void push_back(const ofRectangle& target) {
+			TrackingDistanceBatch<cv::Rect>::push_back(toCv(target));
+		}
+		void getDistances(const ofRectangle& object, int begin, int end, float maximumDistance, float* distances) const {
+			TrackingDistanceBatch<cv::Rect>::getDistances(toCv(object), begin, end, maximumDistance, distances);
+		}
+	};
+	
+	template <>
+	class TrackingDistanceBatch<ofVec2f> : public TrackingDistanceBatch<cv::Point2f> {
+	public:
+		void push_back(const ofVec2f& target) {
+			TrackingDistanceBatch<cv::Point2f>::push_back(toCv(target));
+		}
+		void getDistances(const ofVec2f& object, int begin, int end, float maximumDistance, float* distances) const {
+			TrackingDistanceBatch<cv::Point2f>::getDistances(toCv(object), begin, end, maximumDistance, distances);
+		}
+	};
+	
+	// a flat hash map from labels to indices, using open addressing. labels
+	// start at 1, so label 0 marks an empty slot. it only allocates memory when
+	// it needs to grow, so clearing and refilling it every frame is cheap.
+	class LabelIndex {
+	protected:
+		std::vector<std::pair<unsigned int, int> > slots;
+		std::size_t count;
+		
+		std::size_t getSlot(unsigned int label) const {
+			// fibonacci hashing spreads out consecutive labels
+			return (label * 2654435769u) & (slots.size() - 1);
+		}
+		void grow() {
+			std::vector<std::pair<unsigned int, int> > old;
+			old.swap(slots);
+			slots.assign(old.empty() ? 16 : old.size() * 2, std::make_pair(0u, -1));
+			count = 0;
+			for(std::size_t i = 0; i < old.size(); i++) {
+				if(old[i].first != 0) {
+					set(old[i].first, old[i].second);
+				}
+			}
+		}
+		
+	public:
+		LabelIndex()
+		:count(0) {
+		}
+		void clear() {
+			if(count > 0) {
+				std::fill(slots.begin(), slots.end(), std::make_pair(0u, -1));
+				count = 0;
+			}
+		}
+		void reserve(std::size_t size) {
+			while(slots.size() < size * 2) {
+				grow();
+			}
+		}
+		std::size_t size() const {
+			return count;
+		}
+		void set(unsigned int label, int index) {
+			if((count + 1) * 2 > slots.size()) {
+				grow();
+			}
+			std::size_t i = getSlot(label);
+			while(slots[i].first != 0 && slots[i].first != label) {
+				i = (i + 1) & (slots.size() - 1);
+			}
+			if(slots[i].first == 0) {
+				count++;
+			}
+			slots[i] = std::make_pair(label, index);
+		}
+		// returns -1 if the label isn't in the index
+		int get(unsigned int label) const {
+			if(count == 0) {
+				return -1;
+			}
+			std::size_t i = getSlot(label);
+			while(slots[i].first != 0) {
+				if(slots[i].first == label) {
+					return slots[i].second;
+				}
+				i = (i + 1) & (slots.size() - 1);
+			}
+			return -1;
+		}
+		bool erase(unsigned int label) {
+			if(count == 0) {
+				return false;
+			}
+			std::size_t mask = slots.size() - 1;
+			std::size_t i = getSlot(label);
+			while(slots[i].first != label) {
+				if(slots[i].first == 0) {
+					return false;
+				}
+				i = (i + 1) & mask;
+			}
+			// shift back any following entries that would be unreachable
+			std::size_t j = i;
+			while(true) {
+				j = (j + 1) & mask;
+				if(slots[j].first == 0) {
+					break;
+				}
+				std::size_t home = getSlot(slots[j].first);
+				if(((j - home) & mask) >= ((j - i) & mask)) {
+					slots[i] = slots[j];
+					i = j;
+				}
+			}
+			slots[i] = std::make_pair(0u, -1);
+			count--;
+			return true;
+		}
+	};
 	
 	template <class T>
 	class TrackedObject {
 	protected:
 		unsigned int lastSeen, label, age;
 		int index;
+		cv::Point2f velocity;
 	public:
 		T object;
 		
@@ -66,6 +362,7 @@ namespace ofxCv {
 		,label(label)
 		,age(0)
 		,index(index)
+		,velocity(0, 0)
 		,object(object){
 		}
 		TrackedObject(const T& object, const TrackedObject<T>& previous, int index)
@@ -74,14 +371,22 @@ namespace ofxCv {
 		,age(previous.age)
 		,index(index)
 		,object(object){
+			// average over the frames that the previous object went unseen
+			cv::Point2f offset = TrackingPosition<T>::get(object) - TrackingPosition<T>::get(previous.object);
+			velocity = offset * (1.f / (previous.lastSeen + 1));
 		}
 		TrackedObject(const TrackedObject<T>& old)
 		:lastSeen(old.lastSeen)
 		,label(old.label)
 		,age(old.age)
 		,index(old.index)
+		,velocity(old.velocity)
 		,object(old.object){
 		}
+		// where the object will be if it keeps moving at the same velocity
+		T getPrediction() const {
+			return TrackingPosition<T>::translate(object, velocity * (float) (lastSeen + 1));
+		}
 		void timeStep(bool visible) {
 			age++;
 			if(!visible) {
@@ -100,6 +405,9 @@ namespace ofxCv {
 		int getIndex() const {
 			return index;
 		}
+		const cv::Point2f& getVelocity() const {
+			return velocity;
+		}
 	};
 	
 	struct bySecond {
@@ -109,30 +417,130 @@ namespace ofxCv {
 		}
 	};
 	
+	// ties are broken by index, so the matching doesn't depend on the order
+	// that the possible matches were found in.
+	struct bySecondThenFirst {
+		template <class First, class Second>
+		bool operator()(std::pair<First, Second> const &a, std::pair<First, Second> const &b) const {
+			if(a.second != b.second) {
+				return a.second < b.second;
+			}
+			return a.first < b.first;
+		}
+	};
+	
 	template <class T>
 	class Tracker {
 	protected:		
 		std::vector<TrackedObject<T> > previous, current;
 		std::vector<unsigned int> currentLabels, previousLabels, newLabels, deadLabels;
-		std::map<unsigned int, TrackedObject<T>*> previousLabelMap, currentLabelMap;
+		LabelIndex previousLabelIndex, currentLabelIndex;
+		
+		// buffers that are reused every frame
+		typedef std::pair<int, int> MatchPair;
+		typedef std::pair<MatchPair, float> MatchDistancePair;
+		std::vector<MatchDistancePair> all;
+		std::vector<bool> matchedObjects, matchedPrevious;
+		TrackingDistanceBatch<T> batch;
+		std::vector<float> distances;
+		
+		// the previous objects are compared against their predictions
+		bool usePrediction, predicting;
+		std::vector<T> predicted;
+		const T& getTarget(int j) const {
+			return predicting ? predicted[j] : previous[j].object;
+		}
+		void addCandidates(const T& object, int i, int begin, int end, bool spatial,
+						   std::vector<float>& distances, std::vector<MatchDistancePair>& candidates) const;
+		void findCandidates(const std::vector<T>& objects, int from, int to, bool spatial,
+							std::vector<float>& distances, std::vector<MatchDistancePair>& candidates) const;
+		
+		// each stripe of new objects has its own buffers in parallel mode
+		bool useParallel;
+		std::vector<std::vector<MatchDistancePair> > stripeCandidates;
+		std::vector<std::vector<float> > stripeDistances;
+		std::vector<std::vector<MatchDistancePair> > stripeMerged;
+		void findCandidatesParallel(const std::vector<T>& objects, bool spatial);
+		
+		class ParallelCandidates : public cv::ParallelLoopBody {
+		public:
+			Tracker<T>& tracker;
+			const std::vector<T>& objects;
+			bool spatial;
+			ParallelCandidates(Tracker<T>& tracker, const std::vector<T>& objects, bool spatial)
+			:tracker(tracker)
+			,objects(objects)
+			,spatial(spatial) {
+			}
+			void operator()(const cv::Range& range) const {
+				int n = objects.size(), stripes = tracker.stripeCandidates.size();
+				for(int stripe = range.start; stripe < range.end; stripe++) {
+					std::vector<MatchDistancePair>& candidates = tracker.stripeCandidates[stripe];
+					candidates.clear();
+					tracker.findCandidates(objects, (long long) n * stripe / stripes, (long long) n * (stripe + 1) / stripes,
+										   spatial, tracker.stripeDistances[stripe], candidates);
+					std::sort(candidates.begin(), candidates.end(), bySecondThenFirst());
+				}
+			}
+		};
+		
+		// merges each stripe with the one width stripes after it
+		class ParallelMerge : public cv::ParallelLoopBody {
+		public:
+			Tracker<T>& tracker;
+			int width;
+			ParallelMerge(Tracker<T>& tracker, int width)
+			:tracker(tracker)
+			,width(width) {
+			}
+			void operator()(const cv::Range& range) const {
+				for(int pair = range.start; pair < range.end; pair++) {
+					int left = pair * 2 * width, right = left + width;
+					std::vector<MatchDistancePair>& a = tracker.stripeCandidates[left];
+					std::vector<MatchDistancePair>& b = tracker.stripeCandidates[right];
+					std::vector<MatchDistancePair>& merged = tracker.stripeMerged[left];
+					merged.resize(a.size() + b.size());
+					std::merge(a.begin(), a.end(), b.begin(), b.end(), merged.begin(), bySecondThenFirst());
+					std::swap(a, merged);
+				}
+			}
+		};
 		
 		unsigned int persistence;
 		unsigned long long curLabel;
 		float maximumDistance;
+		TrackingMatchMode matchMode;
+		std::vector<int> assignment;
 		unsigned long long getNewLabel() {
 			curLabel++;
 			return curLabel;
 		}
 		
+		// spatial index over the previous objects: (cell, index) sorted by cell
+		bool useSpatialIndex;
+		std::vector<std::pair<unsigned long long, int> > grid;
+		bool canUseSpatialIndex() const;
+		void buildSpatialIndex();
+		unsigned long long getCell(const cv::Point2f& position, int dx, int dy) const;
+		
 	public:
 		Tracker<T>()
-		:persistence(15)
+		:usePrediction(false)
+		,predicting(false)
+		,useParallel(false)
+		,persistence(15)
 		,curLabel(0)
-		,maximumDistance(64) {
+		,maximumDistance(64)
+		,matchMode(TRACK_MATCH_GREEDY)
+		,useSpatialIndex(false) {
 		}
 		virtual ~Tracker(){};
 		void setPersistence(unsigned int persistence);
 		void setMaximumDistance(float maximumDistance);
+		void setMatchMode(TrackingMatchMode matchMode);
+		void setUseSpatialIndex(bool useSpatialIndex);
+		void setUseParallel(bool useParallel);
+		void setUsePrediction(bool usePrediction);
 		virtual const std::vector<unsigned int>& track(const std::vector<T>& objects);
 		
 		// organized in the order received by track()
@@ -162,39 +570,171 @@ namespace ofxCv {
 		this->maximumDistance = maximumDistance;
 	}
 	
+	template <class T>
+	void Tracker<T>::setMatchMode(TrackingMatchMode matchMode) {
+		this->matchMode = matchMode;
+	}
+	
+	template <class T>
+	void Tracker<T>::setUseSpatialIndex(bool useSpatialIndex) {
+		this->useSpatialIndex = useSpatialIndex;
+	}
+	
+	template <class T>
+	void Tracker<T>::setUseParallel(bool useParallel) {
+		this->useParallel = useParallel;
+	}
+	
+	template <class T>
+	void Tracker<T>::setUsePrediction(bool usePrediction) {
+		this->usePrediction = usePrediction;
+	}
+	
+	template <class T>
+	bool Tracker<T>::canUseSpatialIndex() const {
+		return useSpatialIndex &&
+			TrackingPosition<T>::available &&
+			maximumDistance > 0 &&
+			maximumDistance < std::numeric_limits<float>::infinity();
+	}
+	
+	template <class T>
+	unsigned long long Tracker<T>::getCell(const cv::Point2f& position, int dx, int dy) const {
+		// cells are maximumDistance wide, so any match is at most one cell away.
+		// the offset keeps the keys sorted by row then column.
+		static const double limit = 1 << 30;
+		double x = std::floor(position.x / (double) maximumDistance);
+		double y = std::floor(position.y / (double) maximumDistance);
+		unsigned int cx = (unsigned int) (long long) (std::min(std::max(x, -limit), limit) + dx + limit);
+		unsigned int cy = (unsigned int) (long long) (std::min(std::max(y, -limit), limit) + dy + limit);
+		return ((unsigned long long) cy << 32) | cx;
+	}
+	
+	template <class T>
+	void Tracker<T>::buildSpatialIndex() {
+		grid.resize(previous.size());
+		for(std::size_t j = 0; j < previous.size(); j++) {
+			cv::Point2f position = TrackingPosition<T>::get(getTarget(j));
+			grid[j] = std::make_pair(getCell(position, 0, 0), (int) j);
+		}
+		std::sort(grid.begin(), grid.end());
+	}
+	
+	template <class T>
+	void Tracker<T>::addCandidates(const T& object, int i, int begin, int end, bool spatial,
+								   std::vector<float>& distances, std::vector<MatchDistancePair>& candidates) const {
+		if(begin == end) {
+			return;
+		}
+		batch.getDistances(object, begin, end, maximumDistance, &distances[0]);
+		for(int k = begin; k < end; k++) {
+			float curDistance = distances[k - begin];
+			if(curDistance < maximumDistance) {
+				int j = spatial ? grid[k].second : k;
+				candidates.push_back(MatchDistancePair(MatchPair(i, j), curDistance));
+			}
+		}
+	}
+	
+	template <class T>
+	void Tracker<T>::findCandidates(const std::vector<T>& objects, int from, int to, bool spatial,
+									std::vector<float>& distances, std::vector<MatchDistancePair>& candidates) const {
+		int m = previous.size();
+		distances.resize(m);
+		for(int i = from; i < to; i++) {
+			if(spatial) {
+				// only check the 3x3 neighborhood of cells around each object
+				cv::Point2f position = TrackingPosition<T>::get(objects[i]);
+				for(int dy = -1; dy <= 1; dy++) {
+					std::pair<unsigned long long, int> first(getCell(position, -1, dy), 0);
+					std::pair<unsigned long long, int> last(getCell(position, +1, dy), m);
+					int begin = std::lower_bound(grid.begin(), grid.end(), first) - grid.begin();
+					int end = std::upper_bound(grid.begin() + begin, grid.end(), last) - grid.begin();
+					addCandidates(objects[i], i, begin, end, spatial, distances, candidates);
+				}
+			} else {
+				addCandidates(objects[i], i, 0, m, spatial, distances, candidates);
+			}
+		}
+	}
+	
+	template <class T>
+	void Tracker<T>::findCandidatesParallel(const std::vector<T>& objects, bool spatial) {
+		int stripes = std::max(1, std::min((int) objects.size() / 64, cv::getNumThreads() * 4));
+		stripeCandidates.resize(stripes);
+		stripeDistances.resize(stripes);
+		stripeMerged.resize(stripes);
+		cv::parallel_for_(cv::Range(0, stripes), ParallelCandidates(*this, objects, spatial));
+		
+		// merging neighboring stripes gives the same result as sorting
+		// everything at once, because bySecondThenFirst has no ties. each level
+		// halves the number of stripes, and ends with everything in stripe 0.
+		for(int width = 1; width < stripes; width *= 2) {
+			int pairs = (stripes + width - 1) / (2 * width);
+			cv::parallel_for_(cv::Range(0, pairs), ParallelMerge(*this, width));
+		}
+		std::swap(all, stripeCandidates[0]);
+	}
+	
 	template <class T>
 	const std::vector<unsigned int>& Tracker<T>::track(const std::vector<T>& objects) {
-		previous = current;
+		// the old current objects become the previous objects, and the old
+		// previous buffer is reused for the new current objects
+		std::swap(previous, current);
+		std::swap(previousLabelIndex, currentLabelIndex);
 		int n = objects.size();
 		int m = previous.size();
 		
-		// build NxM distance matrix
-		typedef std::pair<int, int> MatchPair;
-		typedef std::pair<MatchPair, float> MatchDistancePair;
-		std::vector<MatchDistancePair> all;
-		for(int i = 0; i < n; i++) {
+		// predict where the previous objects have moved to
+		predicting = usePrediction && TrackingPosition<T>::available;
+		if(predicting) {
+			predicted.clear();
 			for(int j = 0; j < m; j++) {
-				float curDistance = trackingDistance(objects[i], previous[j].object);
-				if(curDistance < maximumDistance) {
-					all.push_back(MatchDistancePair(MatchPair(i, j), curDistance));
-				}
+				predicted.push_back(previous[j].getPrediction());
 			}
 		}
 		
-		// sort all possible matches by distance
-		sort(all.begin(), all.end(), bySecond());
+		// the previous objects are stored in grid order when using the spatial
+		// index, so each row of neighboring cells is one contiguous range
+		bool spatial = canUseSpatialIndex();
+		if(spatial) {
+			buildSpatialIndex();
+		}
+		batch.clear();
+		for(int k = 0; k < m; k++) {
+			batch.push_back(getTarget(spatial ? grid[k].second : k));
+		}
 		
-		previousLabels = currentLabels;
+		// build NxM distance matrix and sort all possible matches by distance
+		if(useParallel) {
+			findCandidatesParallel(objects, spatial);
+		} else {
+			all.clear();
+			findCandidates(objects, 0, n, spatial, distances, all);
+			sort(all.begin(), all.end(), bySecondThenFirst());
+		}
+		
+		// the optimal matching picks its pairs ahead of time
+		bool optimal = (matchMode == TRACK_MATCH_OPTIMAL);
+		if(optimal) {
+			trackingOptimalAssignment(n, m, all, maximumDistance, assignment);
+		}
+		
+		std::swap(previousLabels, currentLabels);
 		currentLabels.clear();
 		currentLabels.resize(n);
 		current.clear();
-		std::vector<bool> matchedObjects(n, false);
-		std::vector<bool> matchedPrevious(m, false);
+		current.reserve(n + m);
+		matchedObjects.assign(n, false);
+		matchedPrevious.assign(m, false);
 		// walk through matches in order
 		for(int k = 0; k < (int)all.size(); k++) {
 			MatchPair& match = all[k].first;
 			int i = match.first;
 			int j = match.second;
+			if(optimal && assignment[i] != j) {
+				continue;
+			}
 			// only use match if both objects are unmatched, lastSeen is set to 0
 			if(!matchedObjects[i] && !matchedPrevious[j]) {
 				matchedObjects[i] = true;
@@ -231,16 +771,11 @@ namespace ofxCv {
 			}
 		}
 		
-		// build label maps
-		currentLabelMap.clear();
+		// build label index, the previous index is left over from the last frame
+		currentLabelIndex.clear();
+		currentLabelIndex.reserve(current.size());
 		for(std::size_t i = 0; i < current.size(); i++) {
-			unsigned int label = current[i].getLabel();
-			currentLabelMap[label] = &(current[i]);
-		}
-		previousLabelMap.clear();
-		for(std::size_t i = 0; i < previous.size(); i++) {
-			unsigned int label = previous[i].getLabel();
-			previousLabelMap[label] = &(previous[i]);
+			currentLabelIndex.set(current[i].getLabel(), i);
 		}
 		
 		return currentLabels;
@@ -273,43 +808,45 @@ namespace ofxCv {
 	
 	template <class T>
 	int Tracker<T>::getIndexFromLabel(unsigned int label) const {
-		return currentLabelMap.find(label)->second->getIndex();
+		return current[currentLabelIndex.get(label)].getIndex();
 	}
 	
 	template <class T>
 	const T& Tracker<T>::getPrevious(unsigned int label) const {
-		return previousLabelMap.find(label)->second->object;
+		return previous[previousLabelIndex.get(label)].object;
 	}
 	
 	template <class T>
 	const T& Tracker<T>::getCurrent(unsigned int label) const {
-		return currentLabelMap.find(label)->second->object;
+		return current[currentLabelIndex.get(label)].object;
 	}
 	
 	template <class T>
 	bool Tracker<T>::existsCurrent(unsigned int label) const {
-		return currentLabelMap.count(label) > 0;
+		return currentLabelIndex.get(label) >= 0;
 	}
 	
 	template <class T>
 	bool Tracker<T>::existsPrevious(unsigned int label) const {
-		return previousLabelMap.count(label) > 0;
+		return previousLabelIndex.get(label) >= 0;
 	}
 
 	template <class T>
 	int Tracker<T>::getAge(unsigned int label) const{
-		return currentLabelMap.find(label)->second->getAge();
+		return current[currentLabelIndex.get(label)].getAge();
 	}
 
 	template <class T>
 	int Tracker<T>::getLastSeen(unsigned int label) const{
-		return currentLabelMap.find(label)->second->getLastSeen();
+		return current[currentLabelIndex.get(label)].getLastSeen();
 	}
+
 	
 	class RectTracker : public Tracker<cv::Rect> {
 	protected:
 		float smoothingRate;
-		std::map<unsigned int, cv::Rect> smoothed;
+		// smoothed rects in the same order as current and previous
+		std::vector<cv::Rect_<float> > smoothed, previousSmoothed;
 	public:
 		RectTracker()
 		:smoothingRate(.5) {
@@ -322,45 +859,37 @@ namespace ofxCv {
 		}
 		const std::vector<unsigned int>& track(const std::vector<cv::Rect>& objects) {
 			const std::vector<unsigned int>& labels = Tracker<cv::Rect>::track(objects);
-			// add new objects, update old objects
-			for(int i = 0; i < labels.size(); i++) {
-				unsigned int label = labels[i];
-				const cv::Rect& cur = getCurrent(label);
-				if(smoothed.count(label) > 0) {
-					cv::Rect& smooth = smoothed[label];
-					smooth.x = ofLerp(smooth.x, cur.x, smoothingRate);
-					smooth.y = ofLerp(smooth.y, cur.y, smoothingRate);
-					smooth.width = ofLerp(smooth.width, cur.width, smoothingRate);
-					smooth.height = ofLerp(smooth.height, cur.height, smoothingRate);
-				} else {
-					smoothed[label] = cur;
-				}
-			}
-			std::map<unsigned int, cv::Rect>::iterator smoothedItr = smoothed.begin();
-			while(smoothedItr != smoothed.end()) {
-				unsigned int label = smoothedItr->first;
-				if(!existsCurrent(label)) {
-					smoothed.erase(smoothedItr++);
-				} else {
-					++smoothedItr;
+			// one pass over the current objects: new objects start at their rect,
+			// updated objects move towards it and persisting objects stay put.
+			// dead objects aren't in current, so they are dropped automatically.
+			std::swap(smoothed, previousSmoothed);
+			smoothed.resize(current.size());
+			for(std::size_t k = 0; k < current.size(); k++) {
+				const TrackedObject<cv::Rect>& cur = current[k];
+				cv::Rect_<float> rect(cur.object);
+				int j = previousLabelIndex.get(cur.getLabel());
+				if(j >= 0) {
+					cv::Rect_<float>& smooth = previousSmoothed[j];
+					if(cur.getLastSeen() == 0) {
+						smooth.x = ofLerp(smooth.x, rect.x, smoothingRate);
+						smooth.y = ofLerp(smooth.y, rect.y, smoothingRate);
+						smooth.width = ofLerp(smooth.width, rect.width, smoothingRate);
+						smooth.height = ofLerp(smooth.height, rect.height, smoothingRate);
+					}
+					rect = smooth;
 				}
+				smoothed[k] = rect;
 			}
 			return labels;
 		}
-		const cv::Rect& getSmoothed(unsigned int label) const {
-			return smoothed.find(label)->second;
+		const cv::Rect_<float>& getSmoothed(unsigned int label) const {
+			return smoothed[currentLabelIndex.get(label)];
 		}
+		// velocity of the i-th object passed to track(), in pixels per frame
 		cv::Vec2f getVelocity(unsigned int i) const {
 			unsigned int label = getLabelFromIndex(i);
-			if(existsPrevious(label)) {
-				const cv::Rect& previous = getPrevious(label);
-				const cv::Rect& current = getCurrent(label);
-				cv::Vec2f previousPosition(previous.x + previous.width / 2, previous.y + previous.height / 2);
-				cv::Vec2f currentPosition(current.x + current.width / 2, current.y + current.height / 2);
-				return currentPosition - previousPosition;
-			} else {
-				return cv::Vec2f(0, 0);
-			}
+			const cv::Point2f& velocity = current[currentLabelIndex.get(label)].getVelocity();
+			return cv::Vec2f(velocity.x, velocity.y);
 		}
 	};
 	
@@ -400,41 +929,94 @@ namespace ofxCv {
 	template <class T, class F>
 	class TrackerFollower : public Tracker<T> {
 	protected:
+		// alive followers, their labels and their slots in the pool
 		std::vector<unsigned int> labels;
-		std::vector<F> followers;
+		std::vector<F*> followers;
+		std::vector<std::size_t> slots;
+		LabelIndex followerIndex;
+		
+		// a deque never moves its elements when growing at the end
+		std::deque<F> pool;
+		std::vector<std::size_t> freeSlots;
+		
+		// copies handed out by getFollowers()
+		std::vector<F> followerCopies;
+		
+		void removeFollower(std::size_t i) {
+			// rebuild the slot so the dead follower releases its resources,
+			// without needing F to be assignable
+			F* dead = &pool[slots[i]];
+			dead->~F();
+			new (dead) F();
+			freeSlots.push_back(slots[i]);
+			followerIndex.erase(labels[i]);
+			std::size_t last = followers.size() - 1;
+			if(i != last) {
+				followers[i] = followers[last];
+				labels[i] = labels[last];
+				slots[i] = slots[last];
+				followerIndex.set(labels[i], i);
+			}
+			followers.pop_back();
+			labels.pop_back();
+			slots.pop_back();
+		}
 	public:
 		const std::vector<unsigned int>& track(const std::vector<T>& objects) {
 			Tracker<T>::track(objects);
 			// kill missing, update old
-			for(int i = 0; i < labels.size(); i++) {
-				unsigned int curLabel = labels[i];
-				F& curFollower = followers[i];
-				if(!Tracker<T>::existsCurrent(curLabel)) {
-					curFollower.kill();
+			for(std::size_t i = 0; i < labels.size(); i++) {
+				int index = Tracker<T>::currentLabelIndex.get(labels[i]);
+				if(index < 0) {
+					followers[i]->kill();
 				} else {
-					curFollower.update(Tracker<T>::getCurrent(curLabel));
+					followers[i]->update(Tracker<T>::current[index].object);
 				}
 			}
-			// add new
-			for(int i = 0; i < Tracker<T>::newLabels.size(); i++) {
+			// add new, reusing free slots first
+			for(std::size_t i = 0; i < Tracker<T>::newLabels.size(); i++) {
 				unsigned int curLabel = Tracker<T>::newLabels[i];
+				std::size_t slot;
+				if(freeSlots.empty()) {
+					slot = pool.size();
+					pool.emplace_back();
+				} else {
+					slot = freeSlots.back();
+					freeSlots.pop_back();
+				}
+				F& follower = pool[slot];
+				follower.setup(Tracker<T>::getCurrent(curLabel));
+				follower.setLabel(curLabel);
+				followerIndex.set(curLabel, followers.size());
+				followers.push_back(&follower);
 				labels.push_back(curLabel);
-				followers.push_back(F());
-				followers.back().setup(Tracker<T>::getCurrent(curLabel));
-				followers.back().setLabel(curLabel);
+				slots.push_back(slot);
 			}
-			// remove dead
-			for(int i = labels.size() - 1; i >= 0; i--) {
-				if(followers[i].getDead()) {
-					followers.erase(followers.begin() + i);
-					labels.erase(labels.begin() + i);
+			// remove dead, going backwards so swapped in followers were checked
+			for(int i = (int) followers.size() - 1; i >= 0; i--) {
+				if(followers[i]->getDead()) {
+					removeFollower(i);
 				}
 			}
 			return labels;
 		}
-		std::vector<F>& getFollowers() {
+		const std::vector<F*>& getFollowerPointers() const {
 			return followers;
 		}
+		// deprecated: a read-only copy of the alive followers, in the same order
+		// as getFollowerPointers(). every call copies all of them
+		const std::vector<F>& getFollowers() {
+			followerCopies.clear();
+			for(std::size_t i = 0; i < followers.size(); i++) {
+				followerCopies.push_back(*followers[i]);
+			}
+			return followerCopies;
+		}
+		// returns NULL if there is no follower with this label
+		F* getFollower(unsigned int label) {
+			int i = followerIndex.get(label);
+			return i < 0 ? NULL : followers[i];
+		}
 	};
 	
 	template <class F> class RectTrackerFollower : public TrackerFollower<cv::Rect, F> {};
@@ -323,14 +323,18 @@ namespace ofxCv {
 	glm::vec3 toOf(cv::Point3f point);
 	ofRectangle toOf(cv::Rect rect);
 	ofPolyline toOf(cv::RotatedRect rect);
-	template <class T> inline ofPolyline toOf(const std::vector<cv::Point_<T>>& contour) {
-		ofPolyline polyline;
+	template <class T> inline void toOf(const std::vector<cv::Point_<T>>& contour, ofPolyline& polyline) {
+		polyline.clear();
 		polyline.resize(contour.size());
         for(std::size_t i = 0; i < contour.size(); i++) {
 			polyline[i].x = contour[i].x;
 			polyline[i].y = contour[i].y;
 		}
 		polyline.close();
+	}
+	template <class T> inline ofPolyline toOf(const std::vector<cv::Point_<T>>& contour) {
+		ofPolyline polyline;
+		toOf(contour, polyline);
 		return polyline;
 	}
 	template <class T>
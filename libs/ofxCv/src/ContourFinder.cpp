@@ -1,6 +1,7 @@
 #include "ofxCv/ContourFinder.h"
 #include "ofxCv/Wrappers.h"
 #include "ofGraphics.h"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace ofxCv {
     using namespace std;
@@ -21,85 +22,290 @@ namespace ofxCv {
 		const std::vector<double>& mAreaVec;
 	};
 	
+	// a pixel is inside the key when every channel is between lower and upper.
+	// with hue set, the first channel is replaced by its distance around the
+	// hue circle from center before comparing.
+	struct ColorKey {
+		int channels;
+		bool hue;
+		uchar center;
+		uchar lower[3], upper[3];
+		uchar inside, outside;
+	};
+	
+	static void colorKeyRow(const uchar* src, uchar* dst, int width, const ColorKey& key) {
+		int x = 0;
+#if CV_SIMD128
+		cv::v_uint8x16 center = cv::v_setall_u8(key.center), one = cv::v_setall_u8(1);
+		cv::v_uint8x16 lower0 = cv::v_setall_u8(key.lower[0]), upper0 = cv::v_setall_u8(key.upper[0]);
+		cv::v_uint8x16 lower1 = cv::v_setall_u8(key.lower[1]), upper1 = cv::v_setall_u8(key.upper[1]);
+		cv::v_uint8x16 lower2 = cv::v_setall_u8(key.lower[2]), upper2 = cv::v_setall_u8(key.upper[2]);
+		cv::v_uint8x16 inside = cv::v_setall_u8(key.inside), outside = cv::v_setall_u8(key.outside);
+		for(; x <= width - 16; x += 16) {
+			cv::v_uint8x16 a, b, c, d;
+			if(key.channels == 4) {
+				cv::v_load_deinterleave(src + x * 4, a, b, c, d);
+			} else {
+				cv::v_load_deinterleave(src + x * 3, a, b, c);
+			}
+			if(key.hue) {
+				// min(d, 256 - d), where ~d + 1 saturates to 255 when d is 0
+				a = cv::v_absdiff(a, center);
+				a = cv::v_min(a, ~a + one);
+			}
+			cv::v_uint8x16 mask =
+				(a >= lower0) & (a <= upper0) &
+				(b >= lower1) & (b <= upper1) &
+				(c >= lower2) & (c <= upper2);
+			cv::v_store(dst + x, cv::v_select(mask, inside, outside));
+		}
+#endif
+		for(; x < width; x++) {
+			const uchar* pixel = src + x * key.channels;
+			int a = pixel[0], b = pixel[1], c = pixel[2];
+			if(key.hue) {
+				a = std::abs(a - key.center);
+				a = std::min(a, 256 - a);
+			}
+			bool match =
+				a >= key.lower[0] && a <= key.upper[0] &&
+				b >= key.lower[1] && b <= key.upper[1] &&
+				c >= key.lower[2] && c <= key.upper[2];
+			dst[x] = match ? key.inside : key.outside;
+		}
+	}
+	
+	static uchar clampByte(double x) {
+		return cv::saturate_cast<uchar>(cvRound(x));
+	}
+	
 	ContourFinder::ContourFinder()
 	:autoThreshold(true)
 	,invert(false)
 	,simplify(true)
 	,thresholdValue(128.)
 	,useTargetColor(false)
+	,flatReady(false)
 	,contourFindingMode(CV_RETR_EXTERNAL)
-	,sortBySize(false) {
+	,sortBySize(false)
+	,useParallel(false)
+	,statsOnly(false)
+	,needsFullUpdate(true)
+	,rescale(1)
+	,refineMaxArea(0) {
 		resetMinArea();
 		resetMaxArea();
 	}
 	
-	void ContourFinder::findContours(cv::Mat img) {
-		// threshold the image using a tracked color or just binary grayscale
-		if(useTargetColor) {
-			cv::Scalar offset(thresholdValue, thresholdValue, thresholdValue);
-			cv::Scalar base = toCv(targetColor);
-			if(trackingColorMode == TRACK_COLOR_RGB) {
-				inRange(img, base - offset, base + offset, thresh);
-			} else {
-                // all the HSV modes are broken incorrect,
-                // because opencv uses hue 0-180 not 0-255
-                // which means that the math doesn't wrap.
-				if(trackingColorMode == TRACK_COLOR_H) {
-					offset[1] = 255;
-					offset[2] = 255;
+	void ContourFinder::thresholdMask(const cv::Mat& img, cv::Mat& dst) {
+		int channels = img.channels();
+		int thresholdType = invert ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY;
+		dst.create(img.rows, img.cols, CV_8UC1);
+		if(!useTargetColor && channels == 1) {
+			cv::threshold(img, dst, thresholdValue, 255, thresholdType);
+			return;
+		}
+		
+		// converted pixels go through a band of rows small enough to stay in
+		// the cache, so the input is read once and the mask is written once
+		int bandRows = std::min(img.rows, std::max(1, (64 * 1024) / (img.cols * 3)));
+		if(!useTargetColor) {
+			int code = channels == 4 ? CV_RGBA2GRAY : CV_RGB2GRAY;
+			hsvBuffer.create(bandRows, img.cols, CV_8UC1);
+			for(int y = 0; y < img.rows; y += bandRows) {
+				cv::Range rows(y, std::min(y + bandRows, img.rows));
+				cv::Mat band = hsvBuffer.rowRange(0, rows.size());
+				cvtColor(img.rowRange(rows), band, code);
+				cv::threshold(band, dst.rowRange(rows), thresholdValue, 255, thresholdType);
+			}
+			return;
+		}
+		
+		// the binary mask only has two values, so the threshold that used to
+		// follow the color key becomes a choice of the two output values
+		ColorKey key;
+		key.inside = 255;
+		key.outside = 0;
+		if(autoThreshold) {
+			int level = cvFloor(thresholdValue);
+			key.inside = ((255 > level) != invert) ? 255 : 0;
+			key.outside = ((0 > level) != invert) ? 255 : 0;
+		}
+		cv::Vec3d offset(thresholdValue, thresholdValue, thresholdValue);
+		cv::Vec3b base(targetColor.r, targetColor.g, targetColor.b);
+		key.hue = (trackingColorMode != TRACK_COLOR_RGB);
+		if(key.hue) {
+			if(trackingColorMode == TRACK_COLOR_H) {
+				offset[1] = 255;
+				offset[2] = 255;
+			}
+			if(trackingColorMode == TRACK_COLOR_HS) {
+				offset[2] = 255;
+			}
+			// the full range hue goes from 0-255 and wraps around
+			base = convertColor(base, CV_RGB2HSV_FULL);
+		}
+		for(int i = 0; i < 3; i++) {
+			key.lower[i] = clampByte(base[i] - offset[i]);
+			key.upper[i] = clampByte(base[i] + offset[i]);
+		}
+		if(key.hue) {
+			key.center = base[0];
+			key.lower[0] = 0;
+			key.upper[0] = clampByte(offset[0]);
+		}
+		
+		if(key.hue) {
+			key.channels = 3;
+			int code = CV_RGB2HSV_FULL; // also accepts 4 channels
+			hsvBuffer.create(bandRows, img.cols, CV_8UC3);
+			for(int y = 0; y < img.rows; y += bandRows) {
+				int end = std::min(y + bandRows, img.rows);
+				cv::Mat band = hsvBuffer.rowRange(0, end - y);
+				cvtColor(img.rowRange(y, end), band, code);
+				for(int i = y; i < end; i++) {
+					colorKeyRow(band.ptr<uchar>(i - y), dst.ptr<uchar>(i), img.cols, key);
 				}
-				if(trackingColorMode == TRACK_COLOR_HS) {
-					offset[2] = 255;
+			}
+		} else {
+			key.channels = channels;
+			for(int y = 0; y < img.rows; y++) {
+				colorKeyRow(img.ptr<uchar>(y), dst.ptr<uchar>(y), img.cols, key);
+			}
+		}
+	}
+	
+	void ContourFinder::thresholdImage(const cv::Mat& img, cv::Mat& dst) {
+		// 8 bit images go from the input to the binary mask in a single pass
+		int channels = img.channels();
+		bool color = channels == 3 || channels == 4;
+		bool fused = img.depth() == CV_8U && (useTargetColor ? color : autoThreshold && (color || channels == 1));
+		if(fused) {
+			thresholdMask(img, dst);
+		} else {
+			// threshold the image using a tracked color or just binary grayscale
+			if(useTargetColor) {
+				cv::Scalar offset(thresholdValue, thresholdValue, thresholdValue);
+				cv::Scalar base = toCv(targetColor);
+				if(trackingColorMode == TRACK_COLOR_RGB) {
+					inRange(img, base - offset, base + offset, dst);
+				} else {
+					// only the 8 bit path wraps the hue around correctly
+					if(trackingColorMode == TRACK_COLOR_H) {
+						offset[1] = 255;
+						offset[2] = 255;
+					}
+					if(trackingColorMode == TRACK_COLOR_HS) {
+						offset[2] = 255;
+					}
+					cvtColor(img, hsvBuffer, CV_RGB2HSV);
+					base = toCv(convertColor(targetColor, CV_RGB2HSV));
+					cv::Scalar lowerb = base - offset;
+					cv::Scalar upperb = base + offset;
+					inRange(hsvBuffer, lowerb, upperb, dst);
 				}
-				cvtColor(img, hsvBuffer, CV_RGB2HSV);
-				base = toCv(convertColor(targetColor, CV_RGB2HSV));
-				cv::Scalar lowerb = base - offset;
-				cv::Scalar upperb = base + offset;
-				inRange(hsvBuffer, lowerb, upperb, thresh);
+			} else {
+				copyGray(img, dst);
+			}
+			if(autoThreshold) {
+				threshold(dst, thresholdValue, invert);
 			}
+		}
+	}
+	
+	void ContourFinder::findContours(cv::Mat img) {
+		if(rescale != 1) {
+			// find the blobs in a smaller copy of the image
+			cv::resize(img, resized, cv::Size(), rescale, rescale, cv::INTER_AREA);
+			thresholdImage(resized, thresh);
 		} else {
-            copyGray(img, thresh);
+			thresholdImage(img, thresh);
 		}
-		if(autoThreshold) {
-			threshold(thresh, thresholdValue, invert);
+		findBlobs(img, false, false);
+		// the components weren't kept, so the next update has to start over
+		needsFullUpdate = true;
+	}
+	
+	void ContourFinder::findContours(cv::Mat img, const std::vector<cv::Rect>& changed) {
+		// the changed regions don't line up with a smaller mask
+		if(rescale != 1) {
+			findContours(img);
+			return;
 		}
 		
-		// run the contour finder
-		std::vector<std::vector<cv::Point> > allContours;
-		int simplifyMode = simplify ? CV_CHAIN_APPROX_SIMPLE : CV_CHAIN_APPROX_NONE;
-		cv::findContours(thresh, allContours, contourFindingMode, simplifyMode);
-		
-		// filter the contours
-		bool needMinFilter = (minArea > 0);
-		bool needMaxFilter = maxAreaNorm ? (maxArea < 1) : (maxArea < std::numeric_limits<float>::infinity());
-		std::vector<size_t> allIndices;
-		std::vector<double> allAreas;
-        std::vector<bool> allHoles;
-		if(needMinFilter || needMaxFilter) {
-			double imgArea = img.rows * img.cols;
-			double imgMinArea = minAreaNorm ? (minArea * imgArea) : minArea;
-			double imgMaxArea = maxAreaNorm ? (maxArea * imgArea) : maxArea;
-			for(size_t i = 0; i < allContours.size(); i++) {
-				double curArea = cv::contourArea(cv::Mat(allContours[i]), true);
-                bool hole = true;
-                if(curArea < 0) {
-                    curArea = -curArea;
-                    hole = false;
-                }
-
-				if((!needMinFilter || curArea >= imgMinArea) &&
-					 (!needMaxFilter || curArea <= imgMaxArea)) {
-					allIndices.push_back(i);
-                    allHoles.push_back(hole);
-                    allAreas.push_back(curArea);
+		// the mask can only be updated if it was made from the same size of
+		// image with the same settings
+		cv::Rect imgRect(0, 0, img.cols, img.rows);
+		bool full = needsFullUpdate || img.depth() != CV_8U || thresh.size() != img.size() || thresh.type() != CV_8UC1;
+		dirtyRects.clear();
+		if(full) {
+			thresholdImage(img, thresh);
+		} else {
+			// the threshold works on each pixel by itself, so redoing it for the
+			// changed pixels gives the same mask as redoing the whole image
+			for(size_t i = 0; i < changed.size(); i++) {
+				cv::Rect rect = changed[i] & imgRect;
+				if(rect.area() > 0) {
+					cv::Mat dst = thresh(rect);
+					thresholdImage(img(rect), dst);
+					dirtyRects.push_back(rect);
 				}
 			}
+		}
+		findBlobs(img, true, !full);
+		// measuring the components doesn't keep anything to reuse
+		needsFullUpdate = statsOnly;
+	}
+	
+	void ContourFinder::findContours(cv::Mat img, cv::Mat changed) {
+		// find the tiles with any changed pixels, joining tiles along each row
+		static const int tileSize = 32;
+		changedTiles.clear();
+		for(int y = 0; y < changed.rows; y += tileSize) {
+			for(int x = 0; x < changed.cols; x += tileSize) {
+				cv::Rect tile(x, y, std::min(tileSize, changed.cols - x), std::min(tileSize, changed.rows - y));
+				if(cv::countNonZero(changed(tile)) > 0) {
+					if(!changedTiles.empty() && changedTiles.back().y == y && changedTiles.back().br().x == x) {
+						changedTiles.back().width += tile.width;
+					} else {
+						changedTiles.push_back(tile);
+					}
+				}
+			}
+		}
+		findContours(img, changedTiles);
+	}
+	
+	void ContourFinder::findBlobs(const cv::Mat& img, bool keepComponents, bool reuseComponents) {
+		// areas outside of the image area can't happen, so an unused min or max
+		// filter always passes. the areas are given at full resolution, and
+		// scaled down to the size of the mask.
+		double imgArea = img.rows * img.cols;
+		double areaScale = (double) (thresh.rows * thresh.cols) / imgArea;
+		double imgMinArea = (minAreaNorm ? (minArea * imgArea) : minArea) * areaScale;
+		double imgMaxArea = (maxAreaNorm ? (maxArea * imgArea) : maxArea) * areaScale;
+		centroids.clear();
+		if(statsOnly) {
+			findComponentStats(imgMinArea, imgMaxArea);
+		} else if(useParallel || keepComponents) {
+			findContoursByComponent(imgMinArea, imgMaxArea, keepComponents, reuseComponents);
 		} else {
+			// run the contour finder, reusing the storage from the last frame
+			int simplifyMode = simplify ? CV_CHAIN_APPROX_SIMPLE : CV_CHAIN_APPROX_NONE;
+			cv::findContours(thresh, allContours, contourFindingMode, simplifyMode);
+			
+			// filter the contours. areas and holes are indexed by contour, so they
+			// stay aligned with allIndices after sorting.
+			allIndices.clear();
+			allAreas.resize(allContours.size());
+			allHoles.resize(allContours.size());
 			for(size_t i = 0; i < allContours.size(); i++) {
-                double curArea = cv::contourArea(cv::Mat(allContours[i]), true);
-                allAreas.push_back(abs(curArea));
-                allHoles.push_back(curArea > 0);
-				allIndices.push_back(i);
+				double curArea = cv::contourArea(cv::Mat(allContours[i]), true);
+				allHoles[i] = curArea > 0;
+				allAreas[i] = abs(curArea);
+				if(allAreas[i] >= imgMinArea && allAreas[i] <= imgMaxArea) {
+					allIndices.push_back(i);
+				}
 			}
 		}
 
@@ -108,23 +314,438 @@ namespace ofxCv {
 			std::sort(allIndices.begin(), allIndices.end(), CompareContourArea(allAreas));
 		}
 
-		// generate polylines and bounding boxes from the contours
-		contours.clear();
-		polylines.clear();
-        boundingRects.clear();
-        holes.clear();
-
+		// swap the kept contours out instead of copying them. the old contours
+		// go back into allContours, so their memory is reused next frame.
+		contours.resize(allIndices.size());
+		boundingRects.clear();
+		holes.clear();
+		areas.clear();
 		for(size_t i = 0; i < allIndices.size(); i++) {
-			contours.push_back(allContours[allIndices[i]]);
-			polylines.push_back(toOf(contours.back()));
-			boundingRects.push_back(boundingRect(contours.back()));
-            holes.push_back(allHoles[i]);
+			if(statsOnly) {
+				contours[i].clear();
+				boundingRects.push_back(allRects[allIndices[i]]);
+				centroids.push_back(allCentroids[allIndices[i]]);
+			} else {
+				contours[i].swap(allContours[allIndices[i]]);
+				boundingRects.push_back(useParallel ? allRects[allIndices[i]] : boundingRect(contours[i]));
+			}
+			holes.push_back(allHoles[allIndices[i]]);
+			areas.push_back(allAreas[allIndices[i]]);
 		}
+		if(thresh.size() != img.size()) {
+			scaleBlobs(img);
+		}
+		
+		// forget the features from the last frame
+		polylines.resize(contours.size());
+		features.resize(contours.size());
+		for(size_t i = 0; i < features.size(); i++) {
+			features[i].computed = 0;
+		}
+		flatReady = false;
 		
 		// track bounding boxes
 		tracker.track(boundingRects);
 	}
 	
+	void ContourFinder::scaleBlobs(const cv::Mat& img) {
+		// each pixel of the mask covers scale.x by scale.y pixels of the image,
+		// so points go from the center of one to the center of the other
+		cv::Point2f scale((float) img.cols / thresh.cols, (float) img.rows / thresh.rows);
+		cv::Point2f offset((scale.x - 1) / 2, (scale.y - 1) / 2);
+		cv::Rect imgRect(0, 0, img.cols, img.rows);
+		bool refined = false;
+		for(size_t i = 0; i < areas.size(); i++) {
+			std::vector<cv::Point>& contour = contours[i];
+			for(size_t j = 0; j < contour.size(); j++) {
+				contour[j].x = cvRound(contour[j].x * scale.x + offset.x);
+				contour[j].y = cvRound(contour[j].y * scale.y + offset.y);
+			}
+			cv::Rect& rect = boundingRects[i];
+			rect = cv::Rect(cvRound(rect.x * scale.x), cvRound(rect.y * scale.y), cvRound(rect.width * scale.x), cvRound(rect.height * scale.y)) & imgRect;
+			areas[i] *= scale.x * scale.y;
+			if(!centroids.empty()) {
+				centroids[i].x = centroids[i].x * scale.x + offset.x;
+				centroids[i].y = centroids[i].y * scale.y + offset.y;
+			}
+			
+			// small blobs lose the most detail, so they are traced again at
+			// full resolution around where they were found
+			if(areas[i] < refineMaxArea && !holes[i] && !statsOnly && refineBlob(img, i, scale)) {
+				refined = true;
+			}
+		}
+		
+		// the refined areas can pass or fail the area filters differently, and
+		// can change the order of the blobs
+		if(refined) {
+			double imgArea = img.rows * img.cols;
+			double imgMinArea = minAreaNorm ? (minArea * imgArea) : minArea;
+			double imgMaxArea = maxAreaNorm ? (maxArea * imgArea) : maxArea;
+			allIndices.clear();
+			for(size_t i = 0; i < areas.size(); i++) {
+				if(areas[i] >= imgMinArea && areas[i] <= imgMaxArea) {
+					allIndices.push_back(i);
+				}
+			}
+			if(allIndices.size() > 1 && sortBySize) {
+				std::sort(allIndices.begin(), allIndices.end(), CompareContourArea(areas));
+			}
+			refineContours.resize(allIndices.size());
+			allRects.clear();
+			allAreas.clear();
+			allHoles.clear();
+			for(size_t i = 0; i < allIndices.size(); i++) {
+				refineContours[i].swap(contours[allIndices[i]]);
+				allRects.push_back(boundingRects[allIndices[i]]);
+				allAreas.push_back(areas[allIndices[i]]);
+				allHoles.push_back(holes[allIndices[i]]);
+			}
+			contours.swap(refineContours);
+			boundingRects.assign(allRects.begin(), allRects.end());
+			areas.assign(allAreas.begin(), allAreas.end());
+			holes.assign(allHoles.begin(), allHoles.end());
+		}
+	}
+	
+	bool ContourFinder::refineBlob(const cv::Mat& img, size_t i, const cv::Point2f& scale) {
+		std::vector<cv::Point>& contour = contours[i];
+		cv::Rect& rect = boundingRects[i];
+		cv::Rect imgRect(0, 0, img.cols, img.rows);
+		int margin = cvCeil(std::max(scale.x, scale.y));
+		cv::Rect roi(rect.x - margin, rect.y - margin, rect.width + 2 * margin, rect.height + 2 * margin);
+		roi &= imgRect;
+		thresholdImage(img(roi), refineMask);
+		int simplifyMode = simplify ? CV_CHAIN_APPROX_SIMPLE : CV_CHAIN_APPROX_NONE;
+		cv::findContours(refineMask, refineContours, CV_RETR_EXTERNAL, simplifyMode, roi.tl());
+		
+		// other blobs can reach into the region, so keep the contour that best
+		// contains the center of the blob. contours that are cut off by the
+		// region belong to something bigger.
+		cv::Moments moments = cv::moments(contour);
+		cv::Point2f center = moments.m00 > 0 ?
+			cv::Point2f(moments.m10 / moments.m00, moments.m01 / moments.m00) :
+			cv::Point2f(rect.x + rect.width / 2., rect.y + rect.height / 2.);
+		int best = -1;
+		double bestDistance = 0;
+		for(size_t j = 0; j < refineContours.size(); j++) {
+			cv::Rect found = cv::boundingRect(refineContours[j]);
+			bool cut = (found.x <= roi.x && roi.x > 0) ||
+				(found.y <= roi.y && roi.y > 0) ||
+				(found.br().x >= roi.br().x && roi.br().x < img.cols) ||
+				(found.br().y >= roi.br().y && roi.br().y < img.rows);
+			if(cut) {
+				continue;
+			}
+			double distance = cv::pointPolygonTest(refineContours[j], center, true);
+			if(best < 0 || distance > bestDistance) {
+				best = j;
+				bestDistance = distance;
+			}
+		}
+		if(best < 0) {
+			return false;
+		}
+		contour.swap(refineContours[best]);
+		areas[i] = cv::contourArea(contour);
+		rect = cv::boundingRect(contour);
+		return true;
+	}
+	
+	class ContourFinder::ParallelComponents : public cv::ParallelLoopBody {
+	protected:
+		ContourFinder& finder;
+		double minArea, maxArea;
+	public:
+		ParallelComponents(ContourFinder& finder, double minArea, double maxArea)
+		:finder(finder)
+		,minArea(minArea)
+		,maxArea(maxArea) {
+		}
+		void operator()(const cv::Range& range) const {
+			cv::Mat mask;
+			for(int i = range.start; i < range.end; i++) {
+				finder.traceComponent(finder.pending[i], mask, minArea, maxArea);
+			}
+		}
+	};
+	
+	// keeps only the points where the contour changes direction, which is the
+	// same as tracing with CV_CHAIN_APPROX_SIMPLE
+	static void simplifyContour(std::vector<cv::Point>& contour) {
+		int n = contour.size();
+		if(n < 2) {
+			return;
+		}
+		cv::Point first = contour[0];
+		cv::Point prevStep = first - contour[n - 1];
+		int kept = 0;
+		for(int i = 0; i < n; i++) {
+			cv::Point cur = contour[i];
+			cv::Point next = i + 1 < n ? contour[i + 1] : first;
+			cv::Point step = next - cur;
+			if(step != prevStep) {
+				contour[kept++] = cur;
+			}
+			prevStep = step;
+		}
+		contour.resize(kept);
+	}
+	
+	// sorts like the serial contour finder, which returns the contours in the
+	// reverse of the order it finds them in while scanning the image
+	struct ContourFinder::CompareTracedContour {
+		bool operator()(const TracedContour& a, const TracedContour& b) const {
+			if(a.key != b.key) {
+				return a.key > b.key;
+			}
+			if(a.component != b.component) {
+				return a.component < b.component;
+			}
+			return a.index < b.index;
+		}
+	};
+	
+	void ContourFinder::traceComponent(int label, cv::Mat& mask, double minArea, double maxArea) {
+		cv::Rect box = getComponentRect(label);
+		Component& component = components[label - 1];
+		std::vector<std::vector<cv::Point> >& curContours = component.contours;
+		std::vector<TracedContour>& curTraced = component.found;
+		component.traced = true;
+		
+		// trace the component on its own, with a border of background around it
+		mask.create(box.height + 2, box.width + 2, CV_8UC1);
+		mask.setTo(0);
+		cv::Mat inside = mask(cv::Rect(1, 1, box.width, box.height));
+		cv::compare(componentLabels(box), label, inside, cv::CMP_EQ);
+		// holes need the point where the trace started, which the simplified
+		// contours can skip, so they are simplified after tracing instead
+		bool simplifyLater = simplify && contourFindingMode == CV_RETR_LIST;
+		int simplifyMode = simplify && !simplifyLater ? CV_CHAIN_APPROX_SIMPLE : CV_CHAIN_APPROX_NONE;
+		cv::findContours(mask, curContours, contourFindingMode, simplifyMode, cv::Point(box.x - 1, box.y - 1));
+		
+		for(size_t i = 0; i < curContours.size(); i++) {
+			std::vector<cv::Point>& contour = curContours[i];
+			TracedContour cur;
+			
+			// the serial contour finder scans the image and starts tracing at the
+			// first pixel of a component, or just right of the first pixel next
+			// to a hole. the first pixel of a component is its top left point.
+			cv::Point start = contour[0];
+			if(simplifyMode == CV_CHAIN_APPROX_SIMPLE) {
+				for(size_t j = 1; j < contour.size(); j++) {
+					const cv::Point& p = contour[j];
+					if(p.y < start.y || (p.y == start.y && p.x < start.x)) {
+						start = p;
+					}
+				}
+			}
+			if(simplifyLater) {
+				simplifyContour(contour);
+			}
+			
+			double curArea = cv::contourArea(contour, true);
+			cur.hole = curArea > 0;
+			cur.area = abs(curArea);
+			cur.kept = cur.area >= minArea && cur.area <= maxArea;
+			cur.key = (long long) start.y * (thresh.cols + 1) + start.x + (cur.hole ? 1 : 0);
+			cur.component = label - 1;
+			cur.index = i;
+			cur.rect = cv::boundingRect(contour);
+			curTraced.push_back(cur);
+		}
+	}
+	
+	int ContourFinder::labelComponents() {
+		// label the 8-connected components, which opencv does in parallel
+		int n = cv::connectedComponentsWithStats(thresh, componentLabels, componentStats, componentCentroids, 8, CV_32S) - 1;
+		
+		// the background regions touching the image border are the outside
+		if(contourFindingMode == CV_RETR_EXTERNAL) {
+			cv::compare(thresh, 0, background, cv::CMP_EQ);
+			int m = cv::connectedComponents(background, backgroundLabels, 4, CV_32S);
+			exterior.assign(m, 0);
+			int rows = thresh.rows, cols = thresh.cols;
+			for(int x = 0; x < cols; x++) {
+				exterior[backgroundLabels.ptr<int>(0)[x]] = 1;
+				exterior[backgroundLabels.ptr<int>(rows - 1)[x]] = 1;
+			}
+			for(int y = 0; y < rows; y++) {
+				exterior[backgroundLabels.ptr<int>(y)[0]] = 1;
+				exterior[backgroundLabels.ptr<int>(y)[cols - 1]] = 1;
+			}
+			// label 0 is the foreground in backgroundLabels
+			exterior[0] = 0;
+		}
+		return n;
+	}
+	
+	cv::Rect ContourFinder::getComponentRect(int label) const {
+		const int* stats = componentStats.ptr<int>(label);
+		return cv::Rect(stats[cv::CC_STAT_LEFT], stats[cv::CC_STAT_TOP], stats[cv::CC_STAT_WIDTH], stats[cv::CC_STAT_HEIGHT]);
+	}
+	
+	bool ContourFinder::isDirty(const cv::Rect& rect) const {
+		// a component also changes when a pixel next to it changes
+		cv::Rect grown(rect.x - 1, rect.y - 1, rect.width + 2, rect.height + 2);
+		for(size_t i = 0; i < dirtyRects.size(); i++) {
+			if((grown & dirtyRects[i]).area() > 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	cv::Point ContourFinder::getFirstPixel(int label) const {
+		// the top left pixel, where scanning the image first finds a component
+		const int* stats = componentStats.ptr<int>(label);
+		int y = stats[cv::CC_STAT_TOP];
+		const int* row = componentLabels.ptr<int>(y);
+		int x = stats[cv::CC_STAT_LEFT];
+		while(row[x] != label) {
+			x++;
+		}
+		return cv::Point(x, y);
+	}
+	
+	bool ContourFinder::isExterior(int label) const {
+		// components on the image border are next to the outside. otherwise the
+		// pixel above the first pixel of a component is in the background
+		// region around it.
+		cv::Rect box = getComponentRect(label);
+		if(box.x == 0 || box.y == 0 || box.br().x == thresh.cols || box.br().y == thresh.rows) {
+			return true;
+		}
+		cv::Point first = getFirstPixel(label);
+		return exterior[backgroundLabels.ptr<int>(first.y - 1)[first.x]] != 0;
+	}
+	
+	void ContourFinder::findComponentStats(double minArea, double maxArea) {
+		int n = labelComponents();
+		traced.clear();
+		for(int label = 1; label <= n; label++) {
+			const int* stats = componentStats.ptr<int>(label);
+			TracedContour cur;
+			cur.area = stats[cv::CC_STAT_AREA];
+			if(cur.area < minArea || cur.area > maxArea) {
+				continue;
+			}
+			if(contourFindingMode == CV_RETR_EXTERNAL && !isExterior(label)) {
+				continue;
+			}
+			// order the components like their outer contours
+			cv::Point first = getFirstPixel(label);
+			cur.key = (long long) first.y * (thresh.cols + 1) + first.x;
+			cur.component = label;
+			cur.index = 0;
+			cur.hole = false;
+			cur.kept = true;
+			cur.rect = getComponentRect(label);
+			traced.push_back(cur);
+		}
+		std::sort(traced.begin(), traced.end(), CompareTracedContour());
+		
+		allAreas.resize(traced.size());
+		allHoles.resize(traced.size());
+		allRects.resize(traced.size());
+		allCentroids.resize(traced.size());
+		allIndices.resize(traced.size());
+		for(size_t i = 0; i < traced.size(); i++) {
+			const TracedContour& cur = traced[i];
+			const double* centroid = componentCentroids.ptr<double>(cur.component);
+			allAreas[i] = cur.area;
+			allHoles[i] = cur.hole;
+			allRects[i] = cur.rect;
+			allCentroids[i] = cv::Point2f(centroid[0], centroid[1]);
+			allIndices[i] = i;
+		}
+	}
+	
+	void ContourFinder::findContoursByComponent(double minArea, double maxArea, bool keepComponents, bool reuseComponents) {
+		int n = labelComponents();
+		if(reuseComponents) {
+			std::swap(components, previousComponents);
+		}
+		components.resize(n);
+		
+		// a component away from the changes has exactly the same pixels as a
+		// component from the last frame that starts at the same pixel
+		pending.clear();
+		for(int label = 1; label <= n; label++) {
+			Component& cur = components[label - 1];
+			cv::Point first = getFirstPixel(label);
+			cur.key = first.y * thresh.cols + first.x + 1;
+			cur.traced = false;
+			cur.found.clear();
+			// without holes, only components that aren't inside another
+			// component's hole are found
+			cur.visible = contourFindingMode != CV_RETR_EXTERNAL || isExterior(label);
+			if(reuseComponents && !isDirty(getComponentRect(label))) {
+				int previous = previousComponentIndex.get(cur.key);
+				if(previous >= 0 && previousComponents[previous].traced) {
+					Component& old = previousComponents[previous];
+					cur.contours.swap(old.contours);
+					cur.found.swap(old.found);
+					cur.traced = true;
+					for(size_t i = 0; i < cur.found.size(); i++) {
+						TracedContour& contour = cur.found[i];
+						contour.component = label - 1;
+						contour.kept = contour.area >= minArea && contour.area <= maxArea;
+					}
+					continue;
+				}
+			}
+			if(cur.visible) {
+				pending.push_back(label);
+			}
+		}
+		
+		// trace, measure and filter the remaining components on their own
+		cv::parallel_for_(cv::Range(0, pending.size()), ParallelComponents(*this, minArea, maxArea));
+		
+		traced.clear();
+		for(int i = 0; i < n; i++) {
+			const Component& cur = components[i];
+			if(cur.visible && cur.traced) {
+				for(size_t j = 0; j < cur.found.size(); j++) {
+					if(cur.found[j].kept) {
+						traced.push_back(cur.found[j]);
+					}
+				}
+			}
+		}
+		std::sort(traced.begin(), traced.end(), CompareTracedContour());
+		
+		// line the results up with the serial path. the contours are copied
+		// when the components are kept for the next frame.
+		allContours.resize(traced.size());
+		allAreas.resize(traced.size());
+		allHoles.resize(traced.size());
+		allRects.resize(traced.size());
+		allIndices.resize(traced.size());
+		for(size_t i = 0; i < traced.size(); i++) {
+			const TracedContour& cur = traced[i];
+			std::vector<cv::Point>& contour = components[cur.component].contours[cur.index];
+			if(keepComponents) {
+				allContours[i] = contour;
+			} else {
+				allContours[i].swap(contour);
+			}
+			allAreas[i] = cur.area;
+			allHoles[i] = cur.hole;
+			allRects[i] = cur.rect;
+			allIndices[i] = i;
+		}
+		
+		if(keepComponents) {
+			previousComponentIndex.clear();
+			previousComponentIndex.reserve(n);
+			for(int i = 0; i < n; i++) {
+				previousComponentIndex.set(components[i].key, i);
+			}
+		}
+	}
+	
 
 	void ContourFinder::setFindHoles(bool findHoles){
 		if(findHoles){
@@ -132,17 +753,57 @@ namespace ofxCv {
 		}else{
 			contourFindingMode = CV_RETR_EXTERNAL;
 		}
+		needsFullUpdate = true;
 	}
 
 	void ContourFinder::setSortBySize(bool sizeSort) {
 		sortBySize = sizeSort;
 	}
+	
+	void ContourFinder::setUseParallel(bool useParallel) {
+		this->useParallel = useParallel;
+	}
+	
+	void ContourFinder::setStatsOnly(bool statsOnly) {
+		this->statsOnly = statsOnly;
+	}
+	
+	void ContourFinder::setRescale(float rescale) {
+		if(rescale <= 0) {
+			ofLogError("ContourFinder::setRescale") << "rescale must be greater than 0, ignoring " << rescale;
+			return;
+		}
+		this->rescale = rescale;
+	}
+	
+	void ContourFinder::setRefineMaxArea(float refineMaxArea) {
+		this->refineMaxArea = refineMaxArea;
+	}
+	
+	float ContourFinder::getRescale() const {
+		return rescale;
+	}
 
 	const std::vector<std::vector<cv::Point> >& ContourFinder::getContours() const {
 		return contours;
 	}
 	
+	bool ContourFinder::needsFeature(unsigned int i, unsigned int feature) const {
+		// marks the feature as computed, so the caller has to compute it now
+		unsigned int& computed = features[i].computed;
+		if(computed & feature) {
+			return false;
+		}
+		computed |= feature;
+		return true;
+	}
+	
 	const std::vector<ofPolyline>& ContourFinder::getPolylines() const {
+		for(size_t i = 0; i < contours.size(); i++) {
+			if(needsFeature(i, FEATURE_POLYLINE)) {
+				toOf(contours[i], polylines[i]);
+			}
+		}
 		return polylines;
 	}
 	
@@ -150,6 +811,43 @@ namespace ofxCv {
 		return boundingRects;
 	}
 	
+	const FlatContours& ContourFinder::getFlatContours() const {
+		if(flatReady) {
+			return flat;
+		}
+		flatReady = true;
+		
+		// the buffers keep their capacity, so this only allocates when a frame
+		// has more points than any frame before it
+		size_t n = contours.size();
+		size_t total = 0;
+		flat.offsets.resize(n + 1);
+		for(size_t i = 0; i < n; i++) {
+			flat.offsets[i] = total;
+			total += contours[i].size();
+		}
+		flat.offsets[n] = total;
+		flat.points.resize(total);
+		for(size_t i = 0; i < n; i++) {
+			const std::vector<cv::Point>& contour = contours[i];
+			cv::Point2f* dst = total > 0 ? &flat.points[flat.offsets[i]] : NULL;
+			for(size_t j = 0; j < contour.size(); j++) {
+				dst[j] = contour[j];
+			}
+		}
+		flat.rects.assign(boundingRects.begin(), boundingRects.end());
+		flat.areas.assign(areas.begin(), areas.end());
+		flat.holes.assign(holes.begin(), holes.end());
+		flat.labels.assign(tracker.getCurrentLabels().begin(), tracker.getCurrentLabels().end());
+		return flat;
+	}
+	
+	ConstSpan<cv::Point2f> ContourFinder::getFlatContour(unsigned int i) const {
+		const FlatContours& all = getFlatContours();
+		unsigned int begin = all.offsets[i], end = all.offsets[i + 1];
+		return ConstSpan<cv::Point2f>(end > begin ? &all.points[begin] : NULL, end - begin);
+	}
+	
 	unsigned int ContourFinder::size() const {
 		return contours.size();
 	}
@@ -159,6 +857,9 @@ namespace ofxCv {
 	}
 	
 	ofPolyline& ContourFinder::getPolyline(unsigned int i) {
+		if(needsFeature(i, FEATURE_POLYLINE)) {
+			toOf(contours[i], polylines[i]);
+		}
 		return polylines[i];
 	}
 	
@@ -171,8 +872,19 @@ namespace ofxCv {
 		return cv::Point2f(box.x + box.width / 2, box.y + box.height / 2);
 	}
 	
+	const cv::Moments& ContourFinder::getMoments(unsigned int i) const {
+		ContourFeatures& cur = features[i];
+		if(needsFeature(i, FEATURE_MOMENTS)) {
+			cur.moments = moments(contours[i]);
+		}
+		return cur.moments;
+	}
+	
 	cv::Point2f ContourFinder::getCentroid(unsigned int i) const {
-		cv::Moments m = moments(contours[i]);
+		if(!centroids.empty()) {
+			return centroids[i];
+		}
+		const cv::Moments& m = getMoments(i);
 		if(m.m00!=0){
 			return cv::Point2f(m.m10 / m.m00, m.m01 / m.m00);
 		}else{
@@ -190,17 +902,20 @@ namespace ofxCv {
 	}
 	
 	double ContourFinder::getContourArea(unsigned int i) const {
-		return contourArea(contours[i]);
+		// already measured while filtering
+		return areas[i];
 	}
 	
 	double ContourFinder::getArcLength(unsigned int i) const {
 		return arcLength(contours[i], true);
 	}
 	
-	std::vector<cv::Point> ContourFinder::getConvexHull(unsigned int i) const {
-		std::vector<cv::Point> hull;
-		convexHull(contours[i], hull);
-		return hull;
+	const std::vector<cv::Point>& ContourFinder::getConvexHull(unsigned int i) const {
+		ContourFeatures& cur = features[i];
+		if(needsFeature(i, FEATURE_CONVEX_HULL)) {
+			convexHull(contours[i], cur.convexHull);
+		}
+		return cur.convexHull;
 	}
 	
 	std::vector<cv::Vec4i> ContourFinder::getConvexityDefects(unsigned int i) const {
@@ -208,7 +923,11 @@ namespace ofxCv {
 	}
 	
 	cv::RotatedRect ContourFinder::getMinAreaRect(unsigned int i) const {
-		return minAreaRect(contours[i]);
+		ContourFeatures& cur = features[i];
+		if(needsFeature(i, FEATURE_MIN_AREA_RECT)) {
+			cur.minAreaRect = minAreaRect(contours[i]);
+		}
+		return cur.minAreaRect;
 	}
 	
 	cv::Point2f ContourFinder::getMinEnclosingCircle(unsigned int i, float& radius) const {
@@ -218,15 +937,25 @@ namespace ofxCv {
 	}
 	
 	cv::RotatedRect ContourFinder::getFitEllipse(unsigned int i) const {
-		if(contours[i].size() < 5) {
-			return getMinAreaRect(i);
+		ContourFeatures& cur = features[i];
+		if(needsFeature(i, FEATURE_FIT_ELLIPSE)) {
+			if(contours[i].size() < 5) {
+				cur.fitEllipse = getMinAreaRect(i);
+			} else {
+				cur.fitEllipse = fitEllipse(contours[i]);
+			}
 		}
-		return fitEllipse(contours[i]);
+		return cur.fitEllipse;
 	}
 	
-	std::vector<cv::Point> ContourFinder::getFitQuad(unsigned int i) const {
-		std::vector<cv::Point> convexHull = getConvexHull(i);
-		std::vector<cv::Point> quad = convexHull;
+	const std::vector<cv::Point>& ContourFinder::getFitQuad(unsigned int i) const {
+		ContourFeatures& cur = features[i];
+		if(!needsFeature(i, FEATURE_FIT_QUAD)) {
+			return cur.fitQuad;
+		}
+		const std::vector<cv::Point>& convexHull = getConvexHull(i);
+		std::vector<cv::Point>& quad = cur.fitQuad;
+		quad = convexHull;
 		
 		static const unsigned int targetPoints = 4;
 		static const unsigned int maxIterations = 16;
@@ -282,33 +1011,40 @@ namespace ofxCv {
     
 	void ContourFinder::setAutoThreshold(bool autoThreshold) {
 		this->autoThreshold = autoThreshold;
+		needsFullUpdate = true;
 	}
 	
 	void ContourFinder::setThreshold(float thresholdValue) {
 		this->thresholdValue = thresholdValue;
+		needsFullUpdate = true;
 	}
 	
 	void ContourFinder::setInvert(bool invert) {
 		this->invert = invert;
+		needsFullUpdate = true;
 	}
     
     void ContourFinder::setUseTargetColor(bool useTargetColor) {
         this->useTargetColor = useTargetColor;
+        needsFullUpdate = true;
     }
 	
 	void ContourFinder::setTargetColor(ofColor targetColor, TrackingColorMode trackingColorMode) {
 		useTargetColor = true;
 		this->targetColor = targetColor;
 		this->trackingColorMode = trackingColorMode;
+		needsFullUpdate = true;
 	}
 	
 	void ContourFinder::setSimplify(bool simplify) {
 		this->simplify = simplify;
+		needsFullUpdate = true;
 	}
 	
 	void ContourFinder::draw() const {
 		ofPushStyle();
 		ofNoFill();
+		getPolylines();
         for(std::size_t i = 0; i < polylines.size(); i++) {
 			polylines[i].draw();
 			ofDrawRectangle(toOf(getBoundingRect(i)));
@@ -1,19 +1,92 @@
 #include "ofxCv/Flow.h"
 #include "ofGraphics.h"
+#include <atomic>
+#include <condition_variable>
+#include <thread>
 
 namespace ofxCv {
 	
 	using namespace cv;
 	using namespace std;
+	
+	//everything the async worker needs, which only exists once async has
+	//been turned on
+	struct Flow::AsyncState {
+		std::thread worker;
+		std::mutex frameMutex;
+		std::condition_variable frameReady;
+		bool stopping, hasWaitingFrame;
+		cv::Mat submittedFrame, waitingFrame;
+		unsigned long long waitingFrameId;
+		uint64_t waitingFrameTime;
+		std::atomic<unsigned long long> droppedFrames;
+		std::atomic<int> middleSlot;
+		int backSlot, frontSlot;
+		ResultInfo results[3];
+		AsyncState()
+		:stopping(false)
+		,hasWaitingFrame(false)
+		,waitingFrameId(0)
+		,waitingFrameTime(0)
+		,droppedFrames(0)
+		,middleSlot(0)
+		,backSlot(1)
+		,frontSlot(2) {
+		}
+	};
+	
 	Flow::Flow()
-    :hasFlow(false) {
+    :useAsync(false)
+	,frameCount(0)
+	,totalLatency(0)
+	,shownCount(0)
+	,hasFlow(false)
+	,hasResult(false) {
+		shown.frameId = 0;
+		shown.latency = 0;
+		shown.hasFlow = false;
+	}
+	
+	//the images are shared with the original, like any other cv::Mat copy
+	Flow::Flow(const Flow& other)
+	:last(other.last)
+	,curr(other.curr)
+	,useAsync(false)
+	,frameCount(other.frameCount)
+	,shown(other.shown)
+	,totalLatency(other.totalLatency)
+	,shownCount(other.shownCount)
+	,hasFlow(other.hasFlow)
+	,hasResult(other.hasResult) {
+	}
+	
+	Flow& Flow::operator=(const Flow& other){
+		if(this != &other){
+			//the engine's state is copied after this, so the worker has to stop
+			stopWorker();
+			last = other.last;
+			curr = other.curr;
+			frameCount = other.frameCount;
+			shown = other.shown;
+			totalLatency = other.totalLatency;
+			shownCount = other.shownCount;
+			hasFlow = other.hasFlow;
+			hasResult = other.hasResult;
+		}
+		return *this;
 	}
 	
 	Flow::~Flow(){
+		stopWorker();
 	}
 	
 	//call with two images
 	void Flow::calcOpticalFlow(Mat lastImage, Mat currentImage){
+		if(useAsync){
+			ofLogWarning("Flow::calcOpticalFlow") << "only calcOpticalFlow(nextImage) can be used with async";
+			return;
+		}
+		applyRequests();
         if(lastImage.channels() == 1 && currentImage.channels() == 1) {
             calcFlow(lastImage, currentImage);
         } else {
@@ -22,11 +95,43 @@ namespace ofxCv {
             calcFlow(last, curr);
         }
 		hasFlow = true;
+		shown.frameId = ++frameCount;
+		shown.size = currentImage.size();
+		hasResult = true;
+		showResult(-1);
 	}
 	
 	//you can add subsequent images this way without having to store
 	//the previous one yourself
 	void Flow::calcOpticalFlow(Mat nextImage){
+		if(useAsync){
+			update();
+			
+			//copy the frame outside of the lock, then trade it for any frame
+			//that the worker hasn't started yet
+			nextImage.copyTo(async->submittedFrame);
+			{
+				std::lock_guard<std::mutex> lock(async->frameMutex);
+				swap(async->submittedFrame, async->waitingFrame);
+				if(async->hasWaitingFrame){
+					async->droppedFrames++;
+				}
+				async->hasWaitingFrame = true;
+				async->waitingFrameId = ++frameCount;
+				async->waitingFrameTime = ofGetElapsedTimeMicros();
+			}
+			async->frameReady.notify_one();
+			return;
+		}
+		applyRequests();
+		runFlow(nextImage);
+		shown.frameId = ++frameCount;
+		shown.size = nextImage.size();
+		hasResult = hasFlow;
+		showResult(-1);
+	}
+	
+	void Flow::runFlow(Mat nextImage){
         copyGray(nextImage, curr);
 		if(last.size == curr.size){
 			calcFlow(last, curr);
@@ -34,38 +139,166 @@ namespace ofxCv {
 		}
         swap(curr, last);
 	}
+	
+	void Flow::setUseAsync(bool useAsync){
+		if(useAsync == this->useAsync){
+			return;
+		}
+		if(useAsync){
+			if(!async){
+				async.reset(new AsyncState());
+			}
+			startWorker();
+		}else{
+			stopWorker();
+			//go back to reading the results of calcFlow() directly
+			hasResult = hasFlow;
+			showResult(-1);
+		}
+	}
+	
+	void Flow::startWorker(){
+		async->stopping = false;
+		async->hasWaitingFrame = false;
+		async->middleSlot = 0;
+		async->backSlot = 1;
+		async->frontSlot = 2;
+		useAsync = true;
+		async->worker = std::thread(&Flow::threadedFunction, this);
+	}
+	
+	void Flow::stopWorker(){
+		if(!async || !async->worker.joinable()){
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(async->frameMutex);
+			async->stopping = true;
+		}
+		async->frameReady.notify_one();
+		async->worker.join();
+		useAsync = false;
+	}
+	
+	std::unique_lock<std::mutex> Flow::lockRequests(){
+		if(useAsync){
+			return std::unique_lock<std::mutex>(async->frameMutex);
+		}
+		return std::unique_lock<std::mutex>();
+	}
+	
+	//the worker owns backSlot, the caller owns frontSlot, and the newest
+	//finished slot is handed between them through middleSlot. the fresh
+	//bit is set when the middle slot has a result the caller hasn't seen
+	static const int freshSlot = 4;
+	
+	void Flow::threadedFunction(){
+		Mat frame;
+		while(true){
+			unsigned long long frameId;
+			uint64_t frameTime;
+			{
+				std::unique_lock<std::mutex> lock(async->frameMutex);
+				while(!async->hasWaitingFrame && !async->stopping){
+					async->frameReady.wait(lock);
+				}
+				if(async->stopping){
+					return;
+				}
+				swap(frame, async->waitingFrame);
+				async->hasWaitingFrame = false;
+				frameId = async->waitingFrameId;
+				frameTime = async->waitingFrameTime;
+				applyRequests();
+			}
+			
+			runFlow(frame);
+			int backSlot = async->backSlot;
+			storeResult(backSlot);
+			ResultInfo& result = async->results[backSlot];
+			result.frameId = frameId;
+			result.latency = (ofGetElapsedTimeMicros() - frameTime) / 1000.;
+			result.hasFlow = hasFlow;
+			result.size = frame.size();
+			async->backSlot = async->middleSlot.exchange(backSlot | freshSlot) & ~freshSlot;
+		}
+	}
+	
+	bool Flow::update(){
+		if(!useAsync || !(async->middleSlot.load() & freshSlot)){
+			return false;
+		}
+		int frontSlot = async->middleSlot.exchange(async->frontSlot) & ~freshSlot;
+		async->frontSlot = frontSlot;
+		shown = async->results[frontSlot];
+		hasResult = shown.hasFlow;
+		totalLatency += shown.latency;
+		shownCount++;
+		showResult(frontSlot);
+		return true;
+	}
+	
+	unsigned long long Flow::getFrameId() const{
+		return shown.frameId;
+	}
+	
+	unsigned long long Flow::getDroppedFrames() const{
+		return async ? async->droppedFrames.load() : 0;
+	}
+	
+	float Flow::getLatency() const{
+		return shown.latency;
+	}
+	
+	float Flow::getAverageLatency() const{
+		return shownCount > 0 ? totalLatency / shownCount : 0;
+	}
     
 	void Flow::draw(){
-		if(hasFlow) {
+		if(hasResult) {
 			drawFlow(ofRectangle(0, 0, getWidth(), getHeight()));
 		}
 	}
 	void Flow::draw(float x, float y){
-		if(hasFlow){
+		if(hasResult){
 			drawFlow(ofRectangle(x, y, getWidth(), getHeight()));
 		}
 	}
 	void Flow::draw(float x, float y, float width, float height){
-		if(hasFlow){
+		if(hasResult){
 			drawFlow(ofRectangle(x,y,width,height));
 		}
 	}
 	void Flow::draw(ofRectangle rect){
-		if(hasFlow){
+		if(hasResult){
 			drawFlow(rect);
 		}
 	}
 	int Flow::getWidth()  {
-        return curr.cols;
+        return shown.size.width;
     }
 	int Flow::getHeight() {
-        return curr.rows;
+        return shown.size.height;
     }
     void Flow::resetFlow() {
+		//the worker has to be idle while its state is cleared
+		bool wasAsync = useAsync;
+		stopWorker();
+		clearFlow();
+		hasResult = false;
+		shown.frameId = 0;
+		shown.size = cv::Size();
+		showResult(-1);
+		if(wasAsync){
+			startWorker();
+		}
+    }
+	
+	void Flow::clearFlow() {
         last = Mat();
         curr = Mat();
         hasFlow = false;
-    }
+	}
 	
 	FlowPyrLK::FlowPyrLK()
 	:windowSize(32)
@@ -74,11 +307,17 @@ namespace ofxCv {
 	,qualityLevel(0.01)
 	,minDistance(4)
 	,pyramidLevels(10)
+	,minFeatures(0)
+	,useForwardBackward(false)
+	,maxForwardBackwardError(1)
 	,calcFeaturesNextFrame(true)
+	,featureRequest(REQUEST_NONE)
+	,shownSlot(-1)
 	{
 	}
 	
 	FlowPyrLK::~FlowPyrLK(){
+		stopWorker();
 	}
 	
 	void FlowPyrLK::setWindowSize(int winsize){
@@ -96,6 +335,18 @@ namespace ofxCv {
 	void FlowPyrLK::setMinDistance(int minDistance){
 		this->minDistance = minDistance;
 	}
+	void FlowPyrLK::setPyramidLevels(int levels){
+		this->pyramidLevels = levels;
+	}
+	void FlowPyrLK::setMinFeatures(int minFeatures){
+		this->minFeatures = minFeatures;
+	}
+	void FlowPyrLK::setUseForwardBackward(bool useForwardBackward){
+		this->useForwardBackward = useForwardBackward;
+	}
+	void FlowPyrLK::setMaxForwardBackwardError(float maxForwardBackwardError){
+		this->maxForwardBackwardError = maxForwardBackwardError;
+	}
 	
 	void FlowPyrLK::calcFlow(Mat prev, Mat next){
 		if(!nextPts.empty() || calcFeaturesNextFrame){
@@ -108,24 +359,42 @@ namespace ofxCv {
 				calcFeaturesNextFrame = false;
 			}else{
                 swap(prevPts, nextPts);
+				if(minFeatures > 0){
+					refillFeatures(prev);
+				}
 			}
 			nextPts.clear();
 
 #if CV_MAJOR_VERSION>=2 && (CV_MINOR_VERSION>4 || (CV_MINOR_VERSION==4 && CV_SUBMINOR_VERSION>=1))
-			if (prevPyramid.empty()) {
-				buildOpticalFlowPyramid(prev,prevPyramid,cv::Size(windowSize, windowSize),10);
+			//levels past maxLevel would never be used by the tracker
+			int levels = std::min(maxLevel, pyramidLevels);
+			cv::Size winSize(windowSize, windowSize);
+			if (prevPyramid.empty() || prevPyramid[0].size() != prev.size()) {
+				buildOpticalFlowPyramid(prev,prevPyramid,winSize,levels);
 			}
-			buildOpticalFlowPyramid(next,pyramid,cv::Size(windowSize, windowSize),10);
+			buildOpticalFlowPyramid(next,pyramid,winSize,levels);
 			calcOpticalFlowPyrLK(prevPyramid,
                                  pyramid,
                                  prevPts,
                                  nextPts,
                                  status,
                                  err,
-                                 cv::Size(windowSize, windowSize),
-                                 maxLevel);
-			prevPyramid = pyramid;
-			pyramid.clear();
+                                 winSize,
+                                 levels);
+			if(useForwardBackward){
+				//track back through the same pyramids
+				calcOpticalFlowPyrLK(pyramid,
+                                     prevPyramid,
+                                     nextPts,
+                                     backPts,
+                                     backStatus,
+                                     backErr,
+                                     winSize,
+                                     levels);
+				checkForwardBackward();
+			}
+			//the old pyramid is rebuilt in place next frame
+			swap(prevPyramid, pyramid);
 #else
 			calcOpticalFlowPyrLK(prev,
                                  next,
@@ -135,6 +404,17 @@ namespace ofxCv {
                                  err,
                                  cv::Size(windowSize, windowSize),
                                  maxLevel);
+			if(useForwardBackward){
+				calcOpticalFlowPyrLK(next,
+                                     prev,
+                                     nextPts,
+                                     backPts,
+                                     backStatus,
+                                     backErr,
+                                     cv::Size(windowSize, windowSize),
+                                     maxLevel);
+				checkForwardBackward();
+			}
 #endif
 			status.resize(nextPts.size(),0);
 		}else{
@@ -152,62 +432,183 @@ namespace ofxCv {
                             );
 	}
 	
+	void FlowPyrLK::checkForwardBackward(){
+		//features that don't come back to where they started are lost
+		float maxError = maxForwardBackwardError * maxForwardBackwardError;
+		for(std::size_t i = 0; i < status.size(); i++){
+			if(status[i]){
+				Point2f error = backPts[i] - prevPts[i];
+				if(!backStatus[i] || error.dot(error) > maxError){
+					status[i] = 0;
+				}
+			}
+		}
+	}
+	
+	void FlowPyrLK::refillFeatures(Mat prev){
+		//drop the features that were lost last frame
+		if(status.size() == prevPts.size()){
+			std::size_t kept = 0;
+			for(std::size_t i = 0; i < prevPts.size(); i++){
+				if(status[i]){
+					prevPts[kept++] = prevPts[i];
+				}
+			}
+			prevPts.resize(kept);
+		}
+		int count = prevPts.size();
+		if(count >= minFeatures || count >= maxFeatures){
+			return;
+		}
+		
+		//look for new features away from the ones that are left
+		featureMask.create(prev.size(), CV_8UC1);
+		featureMask.setTo(Scalar(255));
+		for(std::size_t i = 0; i < prevPts.size(); i++){
+			circle(featureMask, prevPts[i], minDistance, Scalar(0), -1);
+		}
+		goodFeaturesToTrack(
+                            prev,
+                            newPts,
+                            maxFeatures - count,
+                            qualityLevel,
+                            minDistance,
+                            featureMask
+                            );
+		prevPts.insert(prevPts.end(), newPts.begin(), newPts.end());
+	}
+	
+	//the worker may be using nextPts, so the features are only requested
+	//here. without async they're applied right away
 	void FlowPyrLK::resetFeaturesToTrack(){
-		calcFeaturesNextFrame=true;
+		std::unique_lock<std::mutex> lock = lockRequests();
+		featureRequest = REQUEST_FIND;
+		if(!lock.owns_lock()){
+			applyRequests();
+		}
 	}
 	
 	void FlowPyrLK::setFeaturesToTrack(const std::vector<glm::vec2> & features){
-		nextPts.resize(features.size());
+		std::unique_lock<std::mutex> lock = lockRequests();
+		requestedPts.resize(features.size());
 		for(std::size_t i=0;i<features.size();i++){
-			nextPts[i]=toCv(features[i]);
+			requestedPts[i]=toCv(features[i]);
+		}
+		featureRequest = REQUEST_POINTS;
+		if(!lock.owns_lock()){
+			applyRequests();
 		}
-		calcFeaturesNextFrame = false;
 	}
 	
 	void FlowPyrLK::setFeaturesToTrack(const std::vector<cv::Point2f> & features){
-		nextPts = features;
-		calcFeaturesNextFrame = false;
+		std::unique_lock<std::mutex> lock = lockRequests();
+		requestedPts = features;
+		featureRequest = REQUEST_POINTS;
+		if(!lock.owns_lock()){
+			applyRequests();
+		}
+	}
+	
+	void FlowPyrLK::applyRequests(){
+		if(featureRequest == REQUEST_FIND){
+			calcFeaturesNextFrame = true;
+		}else if(featureRequest == REQUEST_POINTS){
+			swap(nextPts, requestedPts);
+			calcFeaturesNextFrame = false;
+		}
+		featureRequest = REQUEST_NONE;
 	}
 	
     std::vector<glm::vec3> FlowPyrLK::getFeatures(){
-		ofPolyline poly = toOf(prevPts);
-		return poly.getVertices();
+		std::vector<glm::vec3> ret;
+		getFeatures(ret);
+		return ret;
 	}
 	
 	std::vector<glm::vec2> FlowPyrLK::getCurrent(){
 		std::vector<glm::vec2> ret;
-        for(std::size_t i = 0; i < nextPts.size(); i++) {
-			if(status[i]){
-                ret.push_back(toOf(nextPts[i]));
-			}
-		}
+		getCurrent(ret);
 		return ret;
 	}
     
 	std::vector<glm::vec2> FlowPyrLK::getMotion(){
 		std::vector<glm::vec2> ret;
-		for(std::size_t i = 0; i < prevPts.size(); i++) {
-			if(status[i]){
-				ret.push_back(toOf(nextPts[i])-toOf(prevPts[i]));
+		getMotion(ret);
+		return ret;
+	}
+	
+	void FlowPyrLK::getFeatures(std::vector<glm::vec3> & features) const{
+		const std::vector<cv::Point2f>& prev = getPrevPoints();
+		features.resize(prev.size());
+		for(std::size_t i = 0; i < prev.size(); i++) {
+			features[i] = glm::vec3(prev[i].x, prev[i].y, 0);
+		}
+	}
+	
+	void FlowPyrLK::getCurrent(std::vector<glm::vec2> & current) const{
+		const std::vector<cv::Point2f>& next = getNextPoints();
+		const std::vector<uchar>& found = getStatus();
+		current.clear();
+		for(std::size_t i = 0; i < next.size(); i++) {
+			if(found[i]){
+				current.push_back(toOf(next[i]));
+			}
+		}
+	}
+	
+	void FlowPyrLK::getMotion(std::vector<glm::vec2> & motion) const{
+		const std::vector<cv::Point2f>& prev = getPrevPoints();
+		const std::vector<cv::Point2f>& next = getNextPoints();
+		const std::vector<uchar>& found = getStatus();
+		motion.clear();
+		for(std::size_t i = 0; i < prev.size(); i++) {
+			if(found[i]){
+				motion.push_back(toOf(next[i])-toOf(prev[i]));
 			}
 		}
-		return ret;
+	}
+	
+	const std::vector<cv::Point2f>& FlowPyrLK::getPrevPoints() const{
+		return shownSlot < 0 ? prevPts : resultPrevPts[shownSlot];
+	}
+	
+	const std::vector<cv::Point2f>& FlowPyrLK::getNextPoints() const{
+		return shownSlot < 0 ? nextPts : resultNextPts[shownSlot];
+	}
+	
+	const std::vector<uchar>& FlowPyrLK::getStatus() const{
+		return shownSlot < 0 ? status : resultStatus[shownSlot];
+	}
+	
+	void FlowPyrLK::storeResult(int slot){
+		resultPrevPts[slot] = prevPts;
+		resultNextPts[slot] = nextPts;
+		resultStatus[slot] = status;
+	}
+	
+	void FlowPyrLK::showResult(int slot){
+		shownSlot = slot;
 	}
 	
 	void FlowPyrLK::drawFlow(ofRectangle rect) {
+		const std::vector<cv::Point2f>& prev = getPrevPoints();
+		const std::vector<cv::Point2f>& next = getNextPoints();
+		const std::vector<uchar>& found = getStatus();
 		glm::vec2 offset(rect.x,rect.y);
 		glm::vec2 scale(rect.width/getWidth(),rect.height/getHeight());
-		for(std::size_t i = 0; i < prevPts.size(); i++) {
-			if(status[i]){
-				ofDrawLine(toOf(prevPts[i])*scale+offset, toOf(nextPts[i])*scale+offset);
+		for(std::size_t i = 0; i < prev.size(); i++) {
+			if(found[i]){
+				ofDrawLine(toOf(prev[i])*scale+offset, toOf(next[i])*scale+offset);
 			}
 		}
 	}
     
-    void FlowPyrLK::resetFlow(){
-        Flow::resetFlow();
-        resetFeaturesToTrack();
+    void FlowPyrLK::clearFlow(){
+        Flow::clearFlow();
+        calcFeaturesNextFrame = true;
+        featureRequest = REQUEST_NONE;
         prevPts.clear();
+        prevPyramid.clear();
     }
     
     FlowFarneback::FlowFarneback()
@@ -222,6 +623,7 @@ namespace ofxCv {
 	}
 	
 	FlowFarneback::~FlowFarneback(){
+		stopWorker();
 	}
 	
 	void FlowFarneback::setPyramidScale(float scale){
@@ -250,8 +652,8 @@ namespace ofxCv {
 		this->farnebackGaussian = gaussian;
 	}
 	
-	void FlowFarneback::resetFlow(){
-        Flow::resetFlow();
+	void FlowFarneback::clearFlow(){
+        Flow::clearFlow();
 		flow.setTo(0);
 	}
     
@@ -275,35 +677,120 @@ namespace ofxCv {
 								 polySigma,
 								 flags);
 	}
-	Mat& FlowFarneback::getFlow() {
-        if(!hasFlow) {
-            flow = Mat::zeros(1, 1, CV_32FC2);
+	
+#if CV_MAJOR_VERSION>=4
+	FlowDIS::FlowDIS()
+	:dis(DISOpticalFlow::create(DISOpticalFlow::PRESET_FAST))
+	{
+	}
+	
+	FlowDIS::~FlowDIS(){
+		stopWorker();
+	}
+	
+	void FlowDIS::setPreset(int preset){
+		dis = DISOpticalFlow::create(preset);
+	}
+	
+	void FlowDIS::clearFlow(){
+		Flow::clearFlow();
+		flow.release();
+	}
+	
+	void FlowDIS::calcFlow(Mat prev, Mat next){
+		//DIS starts from the flow it's given when it's the right size, which
+		//is the same as OPTFLOW_USE_INITIAL_FLOW for Farneback
+		if(!hasFlow){
+			flow.release();
+		}
+		dis->calc(prev, next, flow);
+	}
+#endif
+	
+	FlowDense::FlowDense()
+	:flowIntegralReady(false)
+	,magnitudeIntegralReady(false)
+	{
+	}
+	
+	void FlowDense::resetIntegrals(){
+		flowIntegralReady = false;
+		magnitudeIntegralReady = false;
+	}
+	
+	const Mat& FlowDense::getFlowIntegral(){
+		if(!flowIntegralReady){
+			integral(field, flowIntegral, CV_64F);
+			flowIntegralReady = true;
+		}
+		return flowIntegral;
+	}
+	
+	const Mat& FlowDense::getMagnitudeIntegral(){
+		if(!magnitudeIntegralReady){
+			split(field, flowChannels);
+			cv::magnitude(flowChannels[0], flowChannels[1], magnitude);
+			integral(magnitude, magnitudeIntegral, CV_64F);
+			magnitudeIntegralReady = true;
+		}
+		return magnitudeIntegral;
+	}
+	
+	void FlowDense::storeResult(int slot){
+		flow.copyTo(results[slot]);
+	}
+	
+	void FlowDense::showResult(int slot){
+		field = slot < 0 ? flow : results[slot];
+		resetIntegrals();
+	}
+	
+	cv::Rect FlowDense::getRegionRect(ofRectangle region) const{
+		return toCv(region) & cv::Rect(0, 0, field.cols, field.rows);
+	}
+	
+	//the sum of a region is four lookups into its summed area table
+	template <class T>
+	static T sumRegion(const Mat& sums, const cv::Rect& rect){
+		if(rect.area() == 0){
+			return T();
+		}
+		return sums.at<T>(rect.y + rect.height, rect.x + rect.width)
+			- sums.at<T>(rect.y, rect.x + rect.width)
+			- sums.at<T>(rect.y + rect.height, rect.x)
+			+ sums.at<T>(rect.y, rect.x);
+	}
+	
+	Mat& FlowDense::getFlow() {
+        if(!hasResult) {
+            field = Mat::zeros(1, 1, CV_32FC2);
         }
-        return flow;
+        return field;
     }
-	glm::vec2 FlowFarneback::getFlowOffset(int x, int y){
-		if(!hasFlow){
+	glm::vec2 FlowDense::getFlowOffset(int x, int y){
+		if(!hasResult){
 			return glm::vec2(0, 0);
 		}
-		const Vec2f& vec = flow.at<Vec2f>(y, x);
+		const Vec2f& vec = field.at<Vec2f>(y, x);
 		return glm::vec2(vec[0], vec[1]);
 	}
-	glm::vec2 FlowFarneback::getFlowPosition(int x, int y){
-		if(!hasFlow){
+	glm::vec2 FlowDense::getFlowPosition(int x, int y){
+		if(!hasResult){
 			return glm::vec2(0, 0);
 		}
-		const Vec2f& vec = flow.at<Vec2f>(y, x);
+		const Vec2f& vec = field.at<Vec2f>(y, x);
 		return glm::vec2(x + vec[0], y + vec[1]);
 	}
-	glm::vec2 FlowFarneback::getTotalFlow(){
-		return getTotalFlowInRegion(ofRectangle(0,0,flow.cols, flow.rows));
+	glm::vec2 FlowDense::getTotalFlow(){
+		return getTotalFlowInRegion(ofRectangle(0,0,field.cols, field.rows));
 	}
-	glm::vec2 FlowFarneback::getAverageFlow(){
-		return getAverageFlowInRegion(ofRectangle(0,0,flow.cols,flow.rows));
+	glm::vec2 FlowDense::getAverageFlow(){
+		return getAverageFlowInRegion(ofRectangle(0,0,field.cols,field.rows));
 	}
 	
-	glm::vec2 FlowFarneback::getAverageFlowInRegion(ofRectangle rect){
-        float area = rect.getArea();
+	glm::vec2 FlowDense::getAverageFlowInRegion(ofRectangle rect){
+		//only the part of the region inside the field is summed
+		float area = getRegionRect(rect).area();
 
         if (area > 0)
         {
@@ -315,24 +802,55 @@ namespace ofxCv {
         }
 	}
 	
-	glm::vec2 FlowFarneback::getTotalFlowInRegion(ofRectangle region){
-		if(!hasFlow){
+	glm::vec2 FlowDense::getTotalFlowInRegion(ofRectangle region){
+		if(!hasResult){
 			return glm::vec2(0, 0);
 		}
 		
-		const Scalar& sc = sum(flow(toCv(region)));
+		const Vec2d& sc = sumRegion<Vec2d>(getFlowIntegral(), getRegionRect(region));
 		return glm::vec2(sc[0], sc[1]);
 	}
 	
-	void FlowFarneback::drawFlow(ofRectangle rect){
-		if(!hasFlow){
+	void FlowDense::getTotalFlowInRegions(const std::vector<ofRectangle>& regions, std::vector<glm::vec2>& totals){
+		totals.resize(regions.size());
+		for(std::size_t i = 0; i < regions.size(); i++){
+			totals[i] = getTotalFlowInRegion(regions[i]);
+		}
+	}
+	
+	void FlowDense::getAverageFlowInRegions(const std::vector<ofRectangle>& regions, std::vector<glm::vec2>& averages){
+		averages.resize(regions.size());
+		for(std::size_t i = 0; i < regions.size(); i++){
+			averages[i] = getAverageFlowInRegion(regions[i]);
+		}
+	}
+	
+	float FlowDense::getTotalMagnitudeInRegion(ofRectangle region){
+		if(!hasResult){
+			return 0;
+		}
+		
+		return sumRegion<double>(getMagnitudeIntegral(), getRegionRect(region));
+	}
+	
+	float FlowDense::getAverageMagnitudeInRegion(ofRectangle region){
+		float area = getRegionRect(region).area();
+		if(area > 0){
+			return getTotalMagnitudeInRegion(region) / area;
+		}else{
+			return 0;
+		}
+	}
+	
+	void FlowDense::drawFlow(ofRectangle rect){
+		if(!hasResult){
 			return;
 		}
 		glm::vec2 offset(rect.x,rect.y);
-		glm::vec2 scale(rect.width/flow.cols, rect.height/flow.rows);
+		glm::vec2 scale(rect.width/field.cols, rect.height/field.rows);
 		int stepSize = 4; //TODO: make class-level parameteric
-		for(int y = 0; y < flow.rows; y += stepSize) {
-			for(int x = 0; x < flow.cols; x += stepSize) {
+		for(int y = 0; y < field.rows; y += stepSize) {
+			for(int x = 0; x < field.cols; x += stepSize) {
 				glm::vec2 cur = glm::vec2(x, y) * scale + offset;
 				ofDrawLine(cur, getFlowPosition(x, y) * scale + offset);
 			}
@@ -14,12 +14,18 @@ namespace ofxCv {
 	,useHistogramEqualization(true)
 	,cannyPruning(false)
 	,findBiggestObject(false)
+	,detectionInterval(1)
+	,framesSinceDetection(0)
+	,minTrackingConfidence(.5)
+	,needsDetection(true)
+	,detectionCount(0)
 	{
 	}
 	void ObjectFinder::setup(std::string cascadeFilename) {
 		cascadeFilename = ofToDataPath(cascadeFilename);
 		if(ofFile(cascadeFilename).exists()) {
 			classifier.load(cascadeFilename);
+			needsDetection = true;
 		} else {
 			ofLogError("ObjectFinder::setup") << "Couldn't find " << cascadeFilename;
 		}
@@ -36,6 +42,20 @@ namespace ofxCv {
 		if(useHistogramEqualization) {
 			equalizeHist(graySmallMat, graySmallMat);
 		}
+		framesSinceDetection++;
+		if(needsDetection || framesSinceDetection >= detectionInterval || !followObjects(graySmallMat)) {
+			detectObjects(graySmallMat);
+		}
+		objects.resize(objectsSmall.size());
+		for(int i = 0; i < objects.size(); i++) {
+            cv::Rect& rect = objects[i];
+			rect = objectsSmall[i];
+			rect.width /= rescale, rect.height /= rescale;
+			rect.x /= rescale, rect.y /= rescale;
+		}
+		tracker.track(objects);
+	}
+	void ObjectFinder::detectObjects(cv::Mat& graySmallMat) {
 		cv::Size minSize, maxSize;
 		float minSide = MIN(graySmallMat.rows, graySmallMat.cols);
 		if(minSizeScale > 0) {
@@ -47,19 +67,48 @@ namespace ofxCv {
             maxSize = cv::Size(side, side);
 		}
         classifier.detectMultiScale(graySmallMat,
-                                    objects,
+                                    objectsSmall,
                                     multiScaleFactor,
                                     minNeighbors,
                                     (cannyPruning ? CASCADE_DO_CANNY_PRUNING : 0) |
                                     (findBiggestObject ? CASCADE_FIND_BIGGEST_OBJECT | CASCADE_DO_ROUGH_SEARCH : 0),
                                     minSize,
                                     maxSize);
-		for(int i = 0; i < objects.size(); i++) {
-            cv::Rect& rect = objects[i];
-			rect.width /= rescale, rect.height /= rescale;
-			rect.x /= rescale, rect.y /= rescale;
+		detectionCount++;
+		needsDetection = false;
+		framesSinceDetection = 0;
+		
+		// keep the patch each object was found in, to follow it until the next detection
+		cv::Rect bounds(0, 0, graySmallMat.cols, graySmallMat.rows);
+		templates.resize(objectsSmall.size());
+		confidences.assign(objectsSmall.size(), 1);
+		for(int i = 0; i < objectsSmall.size(); i++) {
+			objectsSmall[i] &= bounds;
+			graySmallMat(objectsSmall[i]).copyTo(templates[i]);
 		}
-		tracker.track(objects);
+	}
+	bool ObjectFinder::followObjects(cv::Mat& graySmallMat) {
+		// each object can move by half its size in any direction
+		cv::Rect bounds(0, 0, graySmallMat.cols, graySmallMat.rows);
+		for(int i = 0; i < objectsSmall.size(); i++) {
+			cv::Rect& rect = objectsSmall[i];
+			cv::Rect window(rect.x - rect.width / 2, rect.y - rect.height / 2, rect.width * 2, rect.height * 2);
+			window &= bounds;
+			if(rect.area() == 0 || window.width < templates[i].cols + 2 || window.height < templates[i].rows + 2) {
+				return false;
+			}
+			matchTemplate(graySmallMat(window), templates[i], matchResult, TM_CCOEFF_NORMED);
+			double confidence;
+			cv::Point position;
+			minMaxLoc(matchResult, NULL, &confidence, NULL, &position);
+			confidences[i] = confidence;
+			if(confidence < minTrackingConfidence) {
+				return false;
+			}
+			rect.x = window.x + position.x;
+			rect.y = window.y + position.y;
+		}
+		return true;
 	}
 	unsigned int ObjectFinder::size() const {
 		return objects.size();
@@ -68,11 +117,18 @@ namespace ofxCv {
 		return toOf(objects[i]);
 	}
 	ofRectangle ObjectFinder::getObjectSmoothed(unsigned int i) const {
-		return toOf(tracker.getSmoothed(getLabel(i)));
+		const cv::Rect_<float>& smoothed = tracker.getSmoothed(getLabel(i));
+		return ofRectangle(smoothed.x, smoothed.y, smoothed.width, smoothed.height);
 	}
 	cv::Vec2f ObjectFinder::getVelocity(unsigned int i) const {
 		return tracker.getVelocity(i);
 	}
+	float ObjectFinder::getConfidence(unsigned int i) const {
+		return confidences[i];
+	}
+	unsigned int ObjectFinder::getDetectionCount() const {
+		return detectionCount;
+	}
 	unsigned int ObjectFinder::getLabel(unsigned int i) const {
 		return tracker.getCurrentLabels()[i];
 	}
@@ -119,6 +175,7 @@ namespace ofxCv {
 	
 	void ObjectFinder::setRescale(float rescale) {
 		this->rescale = rescale;
+		needsDetection = true;
 	}
 	void ObjectFinder::setMinNeighbors(int minNeighbors) {
 		this->minNeighbors = minNeighbors;
@@ -141,6 +198,12 @@ namespace ofxCv {
 	void ObjectFinder::setMaxSizeScale(float maxSizeScale) {
 		this->maxSizeScale = maxSizeScale;
 	}
+	void ObjectFinder::setDetectionInterval(int detectionInterval) {
+		this->detectionInterval = MAX(detectionInterval, 1);
+	}
+	void ObjectFinder::setMinTrackingConfidence(float minTrackingConfidence) {
+		this->minTrackingConfidence = minTrackingConfidence;
+	}
 	
 	float ObjectFinder::getRescale() const {
 		return rescale;
@@ -166,4 +229,10 @@ namespace ofxCv {
 	float ObjectFinder::getMaxSizeScale() const {
 		return maxSizeScale;
 	}
+	int ObjectFinder::getDetectionInterval() const {
+		return detectionInterval;
+	}
+	float ObjectFinder::getMinTrackingConfidence() const {
+		return minTrackingConfidence;
+	}
 }
@@ -1,7 +1,285 @@
 #include "ofxCv/RunningBackground.h"
 #include "ofxCv/Wrappers.h"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace ofxCv {
+	// everything the per row kernel needs for one frame
+	struct BackgroundRow {
+		int width;
+		RunningBackground::DifferenceMode differenceMode;
+		int thresholdValue;
+		bool ignoreForeground;
+		float rate, keep;
+		int shift, dither;
+	};
+	
+	// the same weights and rounding as cvtColor() uses for CV_RGB2GRAY
+	static inline int grayValue(int r, int g, int b) {
+		return (r * 9798 + g * 19235 + b * 3735 + (1 << 14)) >> 15;
+	}
+	
+	static inline uchar differenceValue(uchar frame, uchar background, RunningBackground::DifferenceMode mode) {
+		switch(mode) {
+			case RunningBackground::BRIGHTER: return frame > background ? frame - background : 0;
+			case RunningBackground::DARKER: return background > frame ? background - frame : 0;
+			default: return frame > background ? frame - background : background - frame;
+		}
+	}
+	
+#if CV_SIMD128
+	static inline cv::v_uint8x16 differenceValue(const cv::v_uint8x16& frame, const cv::v_uint8x16& background, RunningBackground::DifferenceMode mode) {
+		switch(mode) {
+			case RunningBackground::BRIGHTER: return frame - background;
+			case RunningBackground::DARKER: return background - frame;
+			default: return cv::v_absdiff(frame, background);
+		}
+	}
+	
+	// 16 bytes to four vectors of 32 bit lanes
+	static inline void expandBytes(const cv::v_uint8x16& src, cv::v_uint32x4 dst[4]) {
+		cv::v_uint16x8 lo, hi;
+		cv::v_expand(src, lo, hi);
+		cv::v_expand(lo, dst[0], dst[1]);
+		cv::v_expand(hi, dst[2], dst[3]);
+	}
+	
+	// rounds and saturates like convertTo(CV_8U)
+	static inline cv::v_uint8x16 packBytes(const cv::v_float32x4 src[4]) {
+		cv::v_uint16x8 lo = cv::v_pack_u(cv::v_round(src[0]), cv::v_round(src[1]));
+		cv::v_uint16x8 hi = cv::v_pack_u(cv::v_round(src[2]), cv::v_round(src[3]));
+		return cv::v_pack(lo, hi);
+	}
+	
+	// stores the background and difference of 16 pixels, thresholds the gray
+	// difference into mask, and returns the sum of the first channel
+	template <int cn>
+	static inline unsigned int differenceBlock(const cv::v_uint8x16 src[], const cv::v_uint8x16 bg[], uchar* background, uchar* foreground, uchar* thresholded, const BackgroundRow& row, cv::v_uint32x4 mask[4]) {
+		cv::v_uint8x16 diff[3];
+		for(int c = 0; c < cn; c++) {
+			diff[c] = differenceValue(src[c], bg[c], row.differenceMode);
+		}
+		if(cn == 1) {
+			cv::v_store(background, bg[0]);
+			cv::v_store(foreground, diff[0]);
+		} else {
+			cv::v_store_interleave(background, bg[0], bg[1], bg[2]);
+			cv::v_store_interleave(foreground, diff[0], diff[1], diff[2]);
+		}
+		cv::v_uint16x8 diffLo, diffHi;
+		cv::v_uint32x4 sumLo, sumHi;
+		cv::v_expand(diff[0], diffLo, diffHi);
+		cv::v_expand(diffLo + diffHi, sumLo, sumHi);
+		
+		// the gray difference decides the mask, in 32 bit lanes
+		cv::v_uint32x4 gray[4], wide[4];
+		expandBytes(diff[0], gray);
+		if(cn == 3) {
+			cv::v_uint32x4 round = cv::v_setall_u32(1 << 14);
+			cv::v_uint32x4 weights[3] = {cv::v_setall_u32(9798), cv::v_setall_u32(19235), cv::v_setall_u32(3735)};
+			for(int i = 0; i < 4; i++) {
+				gray[i] = gray[i] * weights[0] + round;
+			}
+			for(int c = 1; c < 3; c++) {
+				expandBytes(diff[c], wide);
+				for(int i = 0; i < 4; i++) {
+					gray[i] += wide[i] * weights[c];
+				}
+			}
+			for(int i = 0; i < 4; i++) {
+				gray[i] = gray[i] >> 15;
+			}
+		}
+		cv::v_uint32x4 threshold = cv::v_setall_u32(row.thresholdValue);
+		for(int i = 0; i < 4; i++) {
+			mask[i] = gray[i] > threshold;
+		}
+		cv::v_uint16x8 maskLo = cv::v_pack(mask[0], mask[1]), maskHi = cv::v_pack(mask[2], mask[3]);
+		cv::v_store(thresholded, cv::v_pack(maskLo, maskHi));
+		return cv::v_reduce_sum(sumLo + sumHi);
+	}
+#endif
+	
+	// takes the difference of one pixel and returns whether it's foreground
+	template <int cn>
+	static inline bool differencePixel(const uchar* src, const uchar* bg, uchar* diff, const BackgroundRow& row) {
+		for(int c = 0; c < cn; c++) {
+			diff[c] = differenceValue(src[c], bg[c], row.differenceMode);
+		}
+		int gray = cn == 1 ? diff[0] : grayValue(diff[0], diff[1], diff[2]);
+		return gray > row.thresholdValue;
+	}
+	
+	// one pass over a row: rounds the accumulator to the background, takes the
+	// difference, thresholds its gray value, and learns the frame into the
+	// accumulator. returns the sum of the first channel of the difference.
+	template <int cn>
+	static unsigned int backgroundRow(const uchar* frame, float* accumulator, uchar* background, uchar* foreground, uchar* thresholded, const BackgroundRow& row) {
+		unsigned int sum = 0;
+		int x = 0;
+#if CV_SIMD128
+		if(cn == 1 || cn == 3) {
+			cv::v_float32x4 rate = cv::v_setall_f32(row.rate), keep = cv::v_setall_f32(row.keep);
+			for(; x <= row.width - 16; x += 16) {
+				cv::v_uint8x16 src[3], bg[3];
+				cv::v_float32x4 acc[3][4];
+				if(cn == 1) {
+					src[0] = cv::v_load(frame + x);
+					for(int i = 0; i < 4; i++) {
+						acc[0][i] = cv::v_load(accumulator + x + i * 4);
+					}
+				} else {
+					cv::v_load_deinterleave(frame + x * 3, src[0], src[1], src[2]);
+					for(int i = 0; i < 4; i++) {
+						cv::v_load_deinterleave(accumulator + (x + i * 4) * 3, acc[0][i], acc[1][i], acc[2][i]);
+					}
+				}
+				for(int c = 0; c < cn; c++) {
+					bg[c] = packBytes(acc[c]);
+				}
+				cv::v_uint32x4 mask[4], wide[4];
+				sum += differenceBlock<cn>(src, bg, background + x * cn, foreground + x * cn, thresholded + x, row, mask);
+				
+				// learn every pixel, or only the ones that aren't foreground
+				for(int c = 0; c < cn; c++) {
+					expandBytes(src[c], wide);
+					for(int i = 0; i < 4; i++) {
+						cv::v_float32x4 cur = acc[c][i];
+						cv::v_float32x4 next = cv::v_muladd(cv::v_cvt_f32(cv::v_reinterpret_as_s32(wide[i])), rate, cur * keep);
+						acc[c][i] = row.ignoreForeground ? cv::v_select(cv::v_reinterpret_as_f32(mask[i]), cur, next) : next;
+					}
+				}
+				if(cn == 1) {
+					for(int i = 0; i < 4; i++) {
+						cv::v_store(accumulator + x + i * 4, acc[0][i]);
+					}
+				} else {
+					for(int i = 0; i < 4; i++) {
+						cv::v_store_interleave(accumulator + (x + i * 4) * 3, acc[0][i], acc[1][i], acc[2][i]);
+					}
+				}
+			}
+		}
+#endif
+		for(; x < row.width; x++) {
+			const uchar* src = frame + x * cn;
+			float* acc = accumulator + x * cn;
+			uchar* bg = background + x * cn;
+			uchar* diff = foreground + x * cn;
+			for(int c = 0; c < cn; c++) {
+				bg[c] = cv::saturate_cast<uchar>(acc[c]);
+			}
+			bool foregroundPixel = differencePixel<cn>(src, bg, diff, row);
+			sum += diff[0];
+			thresholded[x] = foregroundPixel ? 255 : 0;
+			if(!(row.ignoreForeground && foregroundPixel)) {
+				for(int c = 0; c < cn; c++) {
+					acc[c] = src[c] * row.rate + acc[c] * row.keep;
+				}
+			}
+		}
+		return sum;
+	}
+	
+	// the same pass with an 8.8 fixed point accumulator, which moves 1 / 2^shift
+	// of the way to the frame. dither is added before the shift so that small
+	// differences still move the accumulator on average instead of stalling.
+	template <int cn>
+	static unsigned int backgroundRowFixed(const uchar* frame, ushort* accumulator, uchar* background, uchar* foreground, uchar* thresholded, const BackgroundRow& row) {
+		unsigned int sum = 0;
+		int x = 0;
+#if CV_SIMD128
+		if(cn == 1 || cn == 3) {
+			cv::v_int32x4 dither = cv::v_setall_s32(row.dither);
+			for(; x <= row.width - 16; x += 16) {
+				cv::v_uint8x16 src[3], bg[3];
+				cv::v_uint16x8 acc[3][2];
+				if(cn == 1) {
+					src[0] = cv::v_load(frame + x);
+					for(int i = 0; i < 2; i++) {
+						acc[0][i] = cv::v_load(accumulator + x + i * 8);
+					}
+				} else {
+					cv::v_load_deinterleave(frame + x * 3, src[0], src[1], src[2]);
+					for(int i = 0; i < 2; i++) {
+						cv::v_load_deinterleave(accumulator + (x + i * 8) * 3, acc[0][i], acc[1][i], acc[2][i]);
+					}
+				}
+				for(int c = 0; c < cn; c++) {
+					bg[c] = cv::v_rshr_pack<8>(acc[c][0], acc[c][1]);
+				}
+				cv::v_uint32x4 mask[4], wide[4], cur[4];
+				sum += differenceBlock<cn>(src, bg, background + x * cn, foreground + x * cn, thresholded + x, row, mask);
+				
+				for(int c = 0; c < cn; c++) {
+					expandBytes(src[c], wide);
+					cv::v_expand(acc[c][0], cur[0], cur[1]);
+					cv::v_expand(acc[c][1], cur[2], cur[3]);
+					for(int i = 0; i < 4; i++) {
+						cv::v_int32x4 prev = cv::v_reinterpret_as_s32(cur[i]);
+						cv::v_int32x4 next = prev + ((cv::v_reinterpret_as_s32(wide[i] << 8) - prev + dither) >> row.shift);
+						if(row.ignoreForeground) {
+							next = cv::v_select(cv::v_reinterpret_as_s32(mask[i]), prev, next);
+						}
+						cur[i] = cv::v_reinterpret_as_u32(next);
+					}
+					acc[c][0] = cv::v_pack(cur[0], cur[1]);
+					acc[c][1] = cv::v_pack(cur[2], cur[3]);
+				}
+				if(cn == 1) {
+					for(int i = 0; i < 2; i++) {
+						cv::v_store(accumulator + x + i * 8, acc[0][i]);
+					}
+				} else {
+					for(int i = 0; i < 2; i++) {
+						cv::v_store_interleave(accumulator + (x + i * 8) * 3, acc[0][i], acc[1][i], acc[2][i]);
+					}
+				}
+			}
+		}
+#endif
+		for(; x < row.width; x++) {
+			const uchar* src = frame + x * cn;
+			ushort* acc = accumulator + x * cn;
+			uchar* bg = background + x * cn;
+			uchar* diff = foreground + x * cn;
+			for(int c = 0; c < cn; c++) {
+				bg[c] = cv::saturate_cast<uchar>((acc[c] + 128) >> 8);
+			}
+			bool foregroundPixel = differencePixel<cn>(src, bg, diff, row);
+			sum += diff[0];
+			thresholded[x] = foregroundPixel ? 255 : 0;
+			if(!(row.ignoreForeground && foregroundPixel)) {
+				for(int c = 0; c < cn; c++) {
+					acc[c] += ((src[c] << 8) - acc[c] + row.dither) >> row.shift;
+				}
+			}
+		}
+		return sum;
+	}
+	
+	// the sample model is split into bands of rows, which are updated on
+	// their own threads. a band only ever changes its own rows.
+	static const int sampleBandRows = 32;
+	static const int randomTableSize = 1 << 16;
+	
+	class RunningBackground::ParallelSamples : public cv::ParallelLoopBody {
+	protected:
+		RunningBackground& model;
+		const cv::Mat& gray;
+		cv::Mat& thresholded;
+	public:
+		ParallelSamples(RunningBackground& model, const cv::Mat& gray, cv::Mat& thresholded)
+		:model(model)
+		,gray(gray)
+		,thresholded(thresholded) {
+		}
+		void operator()(const cv::Range& range) const {
+			for(int band = range.start; band < range.end; band++) {
+				model.updateSampleBand(gray, thresholded, band);
+			}
+		}
+	};
+	
 	RunningBackground::RunningBackground()
 	:learningRate(.0001)
 	,learningTime(900.0)
@@ -9,14 +287,83 @@ namespace ofxCv {
 	,thresholdValue(26)
 	,ignoreForeground(false)
 	,needToReset(false)
-	,differenceMode(ABSDIFF) {
+	,differenceMode(ABSDIFF)
+	,presence(0)
+	,useFixedPoint(false)
+	,frameCount(0)
+	,backgroundMode(RUNNING_AVERAGE)
+	,sampleCount(20)
+	,minMatches(2)
+	,updateFactor(16)
+	,needsBackground(false) {
 	}
 	void RunningBackground::update(cv::Mat frame, cv::Mat& thresholded) {
-		if(needToReset || accumulator.empty()) {
+		if(backgroundMode == SAMPLE_CONSENSUS) {
+			updateSamples(frame, thresholded);
+			return;
+		}
+		
+		// 8 bit frames are handled in one pass per row
+		int channels = frame.channels();
+		bool singlePass = frame.depth() == CV_8U && (channels == 1 || channels == 3 || channels == 4);
+		bool fixedPoint = useFixedPoint && singlePass;
+		int accumulatorDepth = fixedPoint ? CV_16U : CV_32F;
+		if(needToReset || accumulator.empty() || accumulator.size() != frame.size() || accumulator.channels() != frame.channels() || accumulator.depth() != accumulatorDepth) {
 			needToReset = false;
-			frame.convertTo(accumulator, CV_32F);
+			frame.convertTo(accumulator, accumulatorDepth, fixedPoint ? 256 : 1);
 		}
 
+		float curLearningRate = learningRate;
+		if(useLearningTime) {
+			curLearningRate = 1. - powf(1. - (thresholdValue / 255.), 1. / learningTime);
+		}
+		
+		if(singlePass) {
+			background.create(frame.size(), frame.type());
+			foreground.create(frame.size(), frame.type());
+			thresholded.create(frame.size(), CV_8UC1);
+			BackgroundRow row;
+			row.width = frame.cols;
+			row.differenceMode = differenceMode;
+			row.thresholdValue = std::min(thresholdValue, 255u);
+			row.ignoreForeground = ignoreForeground;
+			row.rate = curLearningRate;
+			row.keep = 1 - curLearningRate;
+			
+			// the fixed point rate is the nearest power of two, and the dither
+			// steps through every rounding offset over 2^shift frames
+			row.shift = 16;
+			if(curLearningRate > 0) {
+				row.shift = std::min(std::max(cvRound(-std::log(curLearningRate) / std::log(2.)), 0), 16);
+			}
+			row.dither = row.shift > 0 ? (frameCount * 2654435769u) >> (32 - row.shift) : 0;
+			frameCount++;
+			double sum = 0;
+			for(int y = 0; y < frame.rows; y++) {
+				const uchar* src = frame.ptr<uchar>(y);
+				uchar* bg = background.ptr<uchar>(y);
+				uchar* diff = foreground.ptr<uchar>(y);
+				uchar* dst = thresholded.ptr<uchar>(y);
+				if(fixedPoint) {
+					ushort* acc = accumulator.ptr<ushort>(y);
+					switch(channels) {
+						case 1: sum += backgroundRowFixed<1>(src, acc, bg, diff, dst, row); break;
+						case 3: sum += backgroundRowFixed<3>(src, acc, bg, diff, dst, row); break;
+						case 4: sum += backgroundRowFixed<4>(src, acc, bg, diff, dst, row); break;
+					}
+				} else {
+					float* acc = accumulator.ptr<float>(y);
+					switch(channels) {
+						case 1: sum += backgroundRow<1>(src, acc, bg, diff, dst, row); break;
+						case 3: sum += backgroundRow<3>(src, acc, bg, diff, dst, row); break;
+						case 4: sum += backgroundRow<4>(src, acc, bg, diff, dst, row); break;
+					}
+				}
+			}
+			presence = sum / (255. * frame.total());
+			return;
+		}
+		
 		accumulator.convertTo(background, CV_8U);
 		switch(differenceMode) {
 			case ABSDIFF: cv::absdiff(background, frame, foreground); break;
@@ -27,26 +374,145 @@ namespace ofxCv {
 		int thresholdMode = ignoreForeground ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY;
 		cv::threshold(foregroundGray, thresholded, thresholdValue, 255, thresholdMode);
 
-		float curLearningRate = learningRate;
-		if(useLearningTime) {
-			curLearningRate = 1. - powf(1. - (thresholdValue / 255.), 1. / learningTime);
-		}
 		if(ignoreForeground) {
 			cv::accumulateWeighted(frame, accumulator, curLearningRate, thresholded);
 			cv::bitwise_not(thresholded, thresholded);
 		} else {
 			cv::accumulateWeighted(frame, accumulator, curLearningRate);
 		}
+		presence = cv::mean(foreground)[0] / 255.;
+	}
+	void RunningBackground::updateSamples(cv::Mat frame, cv::Mat& thresholded) {
+		cv::Mat gray = frame;
+		if(frame.channels() != 1 || frame.depth() != CV_8U) {
+			copyGray(frame, grayBuffer);
+			if(grayBuffer.depth() != CV_8U) {
+				grayBuffer.convertTo(grayBuffer, CV_8U);
+			}
+			gray = grayBuffer;
+		}
+		
+		// every sample starts as the first frame, moved by up to a pixel
+		if(needToReset || (int) samples.size() != sampleCount || samples[0].size() != gray.size()) {
+			needToReset = false;
+			if(randomTable.empty()) {
+				randomTable.resize(randomTableSize);
+				for(int i = 0; i < randomTableSize; i++) {
+					randomTable[i] = rng.next();
+				}
+			}
+			cv::Mat padded;
+			cv::copyMakeBorder(gray, padded, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+			samples.resize(sampleCount);
+			for(int i = 0; i < sampleCount; i++) {
+				int dx = rng.uniform(0, 3), dy = rng.uniform(0, 3);
+				padded(cv::Rect(dx, dy, gray.cols, gray.rows)).copyTo(samples[i]);
+			}
+		}
+		
+		// each row starts somewhere else in the random table
+		rowOffsets.resize(gray.rows);
+		for(int y = 0; y < gray.rows; y++) {
+			rowOffsets[y] = rng.next();
+		}
+		int bands = (gray.rows + sampleBandRows - 1) / sampleBandRows;
+		bandCounts.assign(bands, 0);
+		bandSampleRows.resize(bands * sampleCount);
+		bandMatches.resize(bands * gray.cols);
+		thresholded.create(gray.size(), CV_8UC1);
+		cv::parallel_for_(cv::Range(0, bands), ParallelSamples(*this, gray, thresholded));
+		
+		int count = 0;
+		for(int i = 0; i < bands; i++) {
+			count += bandCounts[i];
+		}
+		presence = count / (float) gray.total();
+		foreground = thresholded;
+		needsBackground = true;
+	}
+	
+	void RunningBackground::updateSampleBand(const cv::Mat& gray, cv::Mat& thresholded, int band) {
+		int start = band * sampleBandRows;
+		int end = std::min(start + sampleBandRows, gray.rows);
+		int width = gray.cols;
+		uchar radius = std::min(thresholdValue, 255u);
+		const uchar** sampleRows = &bandSampleRows[band * sampleCount];
+		uchar* matches = &bandMatches[band * width];
+		static const int neighborX[] = {-1, 0, 1, -1, 1, -1, 0, 1};
+		static const int neighborY[] = {-1, -1, -1, 0, 0, 1, 1, 1};
+		int count = 0;
+		for(int y = start; y < end; y++) {
+			const uchar* src = gray.ptr<uchar>(y);
+			uchar* dst = thresholded.ptr<uchar>(y);
+			for(int i = 0; i < sampleCount; i++) {
+				sampleRows[i] = samples[i].ptr<uchar>(y);
+			}
+			
+			// count the samples close to each pixel
+			int x = 0;
+#if CV_SIMD128
+			cv::v_uint8x16 within = cv::v_setall_u8(radius), one = cv::v_setall_u8(1);
+			for(; x <= width - 16; x += 16) {
+				cv::v_uint8x16 value = cv::v_load(src + x), cur = cv::v_setall_u8(0);
+				for(int i = 0; i < sampleCount; i++) {
+					cur += (cv::v_absdiff(value, cv::v_load(sampleRows[i] + x)) <= within) & one;
+				}
+				cv::v_store(matches + x, cur);
+			}
+#endif
+			for(; x < width; x++) {
+				int cur = 0;
+				for(int i = 0; i < sampleCount; i++) {
+					cur += std::abs(src[x] - sampleRows[i][x]) <= radius;
+				}
+				matches[x] = std::min(cur, 255);
+			}
+			
+			// background pixels sometimes replace one of their own samples,
+			// and sometimes one of a neighbor's samples in the same band. each
+			// decision takes its own bits, and the neighbor's come from a second
+			// draw half the table away, so the choices aren't correlated
+			unsigned int offset = rowOffsets[y];
+			for(x = 0; x < width; x++) {
+				if(matches[x] < minMatches) {
+					dst[x] = 255;
+					count++;
+					continue;
+				}
+				dst[x] = 0;
+				unsigned int random = randomTable[(offset + x) & (randomTableSize - 1)];
+				if((random & 0xffff) % updateFactor == 0) {
+					samples[(random >> 16) % sampleCount].ptr<uchar>(y)[x] = src[x];
+				}
+				unsigned int neighbor = randomTable[(offset + x + randomTableSize / 2) & (randomTableSize - 1)];
+				if((neighbor & 0xffff) % updateFactor == 0) {
+					int direction = neighbor >> 29;
+					int nx = std::min(std::max(x + neighborX[direction], 0), width - 1);
+					int ny = std::min(std::max(y + neighborY[direction], start), end - 1);
+					samples[((neighbor >> 16) & 0x1fff) % sampleCount].ptr<uchar>(ny)[nx] = src[x];
+				}
+			}
+		}
+		bandCounts[band] = count;
 	}
+	
 	cv::Mat& RunningBackground::getBackground() {
+		// the sample model's background is the average of its samples
+		if(needsBackground && backgroundMode == SAMPLE_CONSENSUS) {
+			needsBackground = false;
+			samples[0].convertTo(backgroundSum, CV_16U);
+			for(size_t i = 1; i < samples.size(); i++) {
+				cv::add(backgroundSum, samples[i], backgroundSum, cv::noArray(), CV_16U);
+			}
+			backgroundSum.convertTo(background, CV_8U, 1. / samples.size());
+		}
 		return background;
 	}
 	cv::Mat& RunningBackground::getForeground() {
 		return foreground;
 	}
 	float RunningBackground::getPresence() const {
-		// this could be memoized to improve speed
-		return cv::mean(foreground)[0] / 255.;
+		return presence;
 	}
 	void RunningBackground::setThresholdValue(unsigned int thresholdValue) {
 		this->thresholdValue = thresholdValue;
@@ -65,6 +531,26 @@ namespace ofxCv {
 	void RunningBackground::setDifferenceMode(DifferenceMode differenceMode) {
 		this->differenceMode = differenceMode;
 	}
+	void RunningBackground::setUseFixedPoint(bool useFixedPoint) {
+		this->useFixedPoint = useFixedPoint;
+	}
+	void RunningBackground::setBackgroundMode(BackgroundMode backgroundMode) {
+		this->backgroundMode = backgroundMode;
+		// the sample model's foreground is the caller's thresholded image, which
+		// the running average must not write its difference into
+		foreground.release();
+		needToReset = true;
+	}
+	void RunningBackground::setSampleCount(int sampleCount) {
+		this->sampleCount = std::max(1, std::min(sampleCount, 255));
+		needToReset = true;
+	}
+	void RunningBackground::setMinMatches(int minMatches) {
+		this->minMatches = minMatches;
+	}
+	void RunningBackground::setUpdateFactor(int updateFactor) {
+		this->updateFactor = std::max(1, updateFactor);
+	}
 	void RunningBackground::reset() {
 		needToReset = true;
 	}
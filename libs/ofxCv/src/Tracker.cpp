@@ -1,11 +1,127 @@
 #include "ofxCv/Tracker.h"
 
 #include "ofxCv/Utilities.h"
+#include "opencv2/core/hal/intrin.hpp"
 #include "ofRectangle.h"
 #include "ofVec2f.h"
+#include <queue>
+#include <functional>
 
 namespace ofxCv {
 	
+	void trackingOptimalAssignment(int n, int m,
+								   const std::vector<std::pair<std::pair<int, int>, float> >& candidates,
+								   float unmatchedCost,
+								   std::vector<int>& assignment) {
+		const double infinity = std::numeric_limits<double>::infinity();
+		assignment.assign(n, -1);
+		
+		// the candidates of each new object, in compressed rows
+		std::vector<int> start(n + 1, 0), edgeCol(candidates.size());
+		std::vector<double> edgeCost(candidates.size());
+		double total = 0;
+		for(std::size_t k = 0; k < candidates.size(); k++) {
+			start[candidates[k].first.first + 1]++;
+		}
+		for(int i = 0; i < n; i++) {
+			start[i + 1] += start[i];
+		}
+		std::vector<int> next(start.begin(), start.end() - 1);
+		for(std::size_t k = 0; k < candidates.size(); k++) {
+			int e = next[candidates[k].first.first]++;
+			edgeCol[e] = candidates[k].first.second;
+			edgeCost[e] = candidates[k].second;
+			total += candidates[k].second;
+		}
+		
+		// new object i can also stay unmatched by taking column m + i. when
+		// unmatchedCost is infinite, matching more objects should always win,
+		// which any cost above the sum of all the distances does as well.
+		double dummyCost = unmatchedCost < infinity ? unmatchedCost : total + 1;
+		
+		// successive shortest augmenting paths, like the jonker-volgenant
+		// solver, but only following the candidate edges. the column
+		// potentials v keep the reduced costs non-negative for dijkstra.
+		int cols = m + n;
+		std::vector<int> rowToCol(n, -1), colToRow(cols, -1), pred(cols), touched, scanned;
+		std::vector<double> v(cols, 0), dist(cols, infinity), predCost(cols), rowCost(n);
+		std::vector<bool> done(cols, false);
+		typedef std::pair<double, int> QueueEntry;
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+		for(int i0 = 0; i0 < n; i0++) {
+			if(start[i0] == start[i0 + 1]) {
+				continue;
+			}
+			int i = i0, sink = -1;
+			double offset = 0;
+			while(true) {
+				// relax the candidates of row i, and its unmatched column
+				for(int e = start[i]; e <= start[i + 1]; e++) {
+					int j = e < start[i + 1] ? edgeCol[e] : m + i;
+					double cost = e < start[i + 1] ? edgeCost[e] : dummyCost;
+					double cur = offset + cost - v[j];
+					if(!done[j] && cur < dist[j]) {
+						if(dist[j] == infinity) {
+							touched.push_back(j);
+						}
+						dist[j] = cur;
+						pred[j] = i;
+						predCost[j] = cost;
+						queue.push(QueueEntry(cur, j));
+					}
+				}
+				
+				// the closest column is either free, which ends the path, or
+				// leads on to the row it's matched with
+				int j = -1;
+				while(!queue.empty()) {
+					QueueEntry top = queue.top();
+					queue.pop();
+					if(!done[top.second] && top.first <= dist[top.second]) {
+						j = top.second;
+						break;
+					}
+				}
+				if(colToRow[j] < 0) {
+					sink = j;
+					break;
+				}
+				done[j] = true;
+				scanned.push_back(j);
+				i = colToRow[j];
+				offset = dist[j] - (rowCost[i] - v[j]);
+			}
+			
+			for(std::size_t k = 0; k < scanned.size(); k++) {
+				v[scanned[k]] += dist[scanned[k]] - dist[sink];
+			}
+			for(int j = sink;;) {
+				int i = pred[j], previousCol = rowToCol[i];
+				rowToCol[i] = j;
+				colToRow[j] = i;
+				rowCost[i] = predCost[j];
+				if(i == i0) {
+					break;
+				}
+				j = previousCol;
+			}
+			
+			for(std::size_t k = 0; k < touched.size(); k++) {
+				dist[touched[k]] = infinity;
+				done[touched[k]] = false;
+			}
+			touched.clear();
+			scanned.clear();
+			queue = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> >();
+		}
+		
+		for(int i = 0; i < n; i++) {
+			if(rowToCol[i] >= 0 && rowToCol[i] < m) {
+				assignment[i] = rowToCol[i];
+			}
+		}
+	}
+	
 	float trackingDistance(const cv::Rect& a, const cv::Rect& b) {
 		float dx = (a.x + a.width / 2.) - (b.x + b.width / 2.);
 		float dy = (a.y + a.height / 2.) - (b.y + b.height / 2.);
@@ -30,4 +146,87 @@ namespace ofxCv {
 		return trackingDistance(toCv(a), toCv(b));
 	}
 	
+	void TrackingDistanceBatch<cv::Rect>::clear() {
+		x.clear(), y.clear(), width.clear(), height.clear();
+	}
+	
+	void TrackingDistanceBatch<cv::Rect>::push_back(const cv::Rect& target) {
+		x.push_back(target.x + target.width / 2.);
+		y.push_back(target.y + target.height / 2.);
+		width.push_back(target.width);
+		height.push_back(target.height);
+	}
+	
+	std::size_t TrackingDistanceBatch<cv::Rect>::size() const {
+		return x.size();
+	}
+	
+	void TrackingDistanceBatch<cv::Rect>::getDistances(const cv::Rect& object, int begin, int end, float maximumDistance, float* distances) const {
+		// the position distance alone has to be under maximumDistance, so the
+		// square roots are skipped when it's too far for every lane
+		float ox = object.x + object.width / 2., oy = object.y + object.height / 2.;
+		float ow = object.width, oh = object.height;
+		int k = begin;
+#if CV_SIMD128
+		cv::v_float32x4 vox = cv::v_setall_f32(ox), voy = cv::v_setall_f32(oy);
+		cv::v_float32x4 vow = cv::v_setall_f32(ow), voh = cv::v_setall_f32(oh);
+		cv::v_float32x4 vmax2 = cv::v_setall_f32(maximumDistance * maximumDistance);
+		cv::v_float32x4 vfar = cv::v_setall_f32(std::numeric_limits<float>::infinity());
+		for(; k + 4 <= end; k += 4) {
+			cv::v_float32x4 dx = vox - cv::v_load(&x[k]);
+			cv::v_float32x4 dy = voy - cv::v_load(&y[k]);
+			cv::v_float32x4 pd2 = dx * dx + dy * dy;
+			if(!cv::v_check_any(pd2 < vmax2)) {
+				cv::v_store(distances + k - begin, vfar);
+				continue;
+			}
+			cv::v_float32x4 dw = vow - cv::v_load(&width[k]);
+			cv::v_float32x4 dh = voh - cv::v_load(&height[k]);
+			cv::v_float32x4 sd2 = dw * dw + dh * dh;
+			cv::v_store(distances + k - begin, cv::v_sqrt(pd2) + cv::v_sqrt(sd2));
+		}
+#endif
+		for(; k < end; k++) {
+			float dx = ox - x[k], dy = oy - y[k];
+			float dw = ow - width[k], dh = oh - height[k];
+			distances[k - begin] = sqrtf(dx * dx + dy * dy) + sqrtf(dw * dw + dh * dh);
+		}
+	}
+	
+	void TrackingDistanceBatch<cv::Point2f>::clear() {
+		x.clear(), y.clear();
+	}
+	
+	void TrackingDistanceBatch<cv::Point2f>::push_back(const cv::Point2f& target) {
+		x.push_back(target.x);
+		y.push_back(target.y);
+	}
+	
+	std::size_t TrackingDistanceBatch<cv::Point2f>::size() const {
+		return x.size();
+	}
+	
+	void TrackingDistanceBatch<cv::Point2f>::getDistances(const cv::Point2f& object, int begin, int end, float maximumDistance, float* distances) const {
+		int k = begin;
+#if CV_SIMD128
+		cv::v_float32x4 vox = cv::v_setall_f32(object.x), voy = cv::v_setall_f32(object.y);
+		cv::v_float32x4 vmax2 = cv::v_setall_f32(maximumDistance * maximumDistance);
+		cv::v_float32x4 vfar = cv::v_setall_f32(std::numeric_limits<float>::infinity());
+		for(; k + 4 <= end; k += 4) {
+			cv::v_float32x4 dx = vox - cv::v_load(&x[k]);
+			cv::v_float32x4 dy = voy - cv::v_load(&y[k]);
+			cv::v_float32x4 d2 = dx * dx + dy * dy;
+			if(!cv::v_check_any(d2 < vmax2)) {
+				cv::v_store(distances + k - begin, vfar);
+			} else {
+				cv::v_store(distances + k - begin, cv::v_sqrt(d2));
+			}
+		}
+#endif
+		for(; k < end; k++) {
+			float dx = object.x - x[k], dy = object.y - y[k];
+			distances[k - begin] = sqrtf(dx * dx + dy * dy);
+		}
+	}
+	
 }
\ No newline at end of file